@@ -1,17 +1,24 @@
 #pragma once
 
 #include "apu/apu_io_registers.hpp"
+#include "apu/psg.hpp"
+#include "apu/resampler.hpp"
 #include "common/circular_queue.hpp"
 #include "dma/controller.hpp"
 #include "int.hpp"
-#include "platform/sfml/audio.hpp"
+#include "audio_sink.hpp"
+#include "system_clock.hpp"
 #include <algorithm>
-// #include <fstream>
+#include <memory>
+#include <vector>
 
 class APU : public APUIORegisters {
 
 public:
-	APU(std::function<void()> FIFOACallback, std::function<void()> FIFOBCallback);
+	// Output rate before resampling to the sink's
+	static const U32 SAMPLE_RATE = 32768;
+
+	APU(std::shared_ptr<SystemClock> clock, std::function<void()> FIFOACallback, std::function<void()> FIFOBCallback, std::shared_ptr<AudioSink> audioSink);
 
 	U32 Read(const AccessSize& size,
 		U32 address,
@@ -22,21 +29,66 @@ public:
 		const Sequentiality&) override;
 
 	void Tick(U32 t);
+	// Hands the sink what is left of the last block and closes it
+	void Close();
 	void FIFOUpdate(U8 timerID);
-
-	void Sample();
+	// Sound DMA refills, bypassing the IO register path
+	void FIFOWrite(U8 fifo, const S8* samples, size_t count);
 
 private:
-	// std::ofstream out { "gba.raw", std::ios::binary };
-
 	std::array<std::function<void()>, 2> FifoCallbacks;
 
 	static const U8 FIFO_SIZE = 32;
 	CircularQueue<S8, FIFO_SIZE> fifo[2];
 
+	// Mixing
+	// Output samples are produced for the time elapsed since the last mix, in batches
+	void MixUntil(std::uint64_t time);
+	void MixSample();
+	void PushSampleBlock();
+	void DecodeMixerRegisters();
+
+	// A FIFO's output changing to a new sample
+	struct SampleEvent {
+		std::uint64_t time;
+		U8 fifo;
+		S8 sample;
+	};
+	std::vector<SampleEvent> sampleEvents;
+
+	// Output of the FIFOs at the point being mixed
 	S8 lastSample[2] = {};
 
-	U32 ticks = 0;
+	std::uint64_t now = 0, nextSampleTime;
+	// Time of a register access, including the cycles charged since the last Tick
+	std::uint64_t AccessTime() const { return now + clock->Unchecked(); }
+	std::shared_ptr<SystemClock> clock;
+
+	// https://problemkaputt.de/gbatek.htm#gbasoundcontrolregisters
+	struct SoundCntH {
+		SoundCntH(U16 value = 0);
+		U8 aVolume;
+		U8 bVolume;
+		bool enableA[2];
+		bool enableB[2];
+		U8 timerSelect[2];
+		// PSG output is shifted right by this
+		U8 psgVolumeShift;
+	} soundCntH;
+	U16 biasLevel = 0;
+
+	PSG psg;
+
+	// Samples are handed to the sink in blocks, resampled if its rate differs
+	static const U32 SAMPLE_BLOCK_SIZE = 128;
+	std::array<S16, SAMPLE_BLOCK_SIZE> sampleBlock {};
+	U32 sampleBlockCount = 0;
+	std::shared_ptr<AudioSink> audioSink;
+	bool resample;
+	Resampler resampler;
+	std::vector<S16> resampledBlock;
 
-	AudioStream audioStream;
+	// Nudges the resampling rate to hold the sink's queue at its target
+	void UpdateRateControl();
+	double averageBuffered;
 };
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "int.hpp"
+#include <array>
+
+// Programmable sound generator: two square wave channels (the first with a
+// frequency sweep), a wave RAM channel and a noise channel.
+// Channels are advanced a whole output sample at a time instead of per cycle.
+// https://problemkaputt.de/gbatek.htm#gbasoundchannel1tonesweep
+class PSG {
+public:
+	static const U32 CHANNELS = 4;
+
+	// Called after the register's halfword changed; restart is set when the write
+	// included its upper byte, where the restart bit lives
+	void WriteRegister(U32 address, U16 value, bool upperByteWritten);
+	// Wave RAM writes go to the bank that isn't being played
+	void WriteWaveRAM(U32 offset, U8 value);
+
+	// Advances every channel by the given number of cycles and returns the mixed
+	// left and right output, before the SOUNDCNT_H PSG volume is applied
+	void Sample(U32 cycles, S16& left, S16& right);
+
+	// Channel on flags, as read from SOUNDCNT_X
+	U8 Status() const;
+
+private:
+	struct Envelope {
+		void Write(U16 value);
+		void Restart();
+		void Clock();
+
+		U8 initialVolume = 0, stepTime = 0, volume = 0, timer = 0;
+		bool increase = false;
+	};
+
+	struct Length {
+		// The register holds how much of maxLength has already elapsed
+		void Load(U16 elapsed) { counter = maxLength - elapsed; }
+		void Restart();
+		// Returns false once the channel runs out
+		bool Clock();
+
+		U16 counter = 0, maxLength = 64;
+		bool enabled = false;
+	};
+
+	// Counts the timer down by cycles, reloading it with period, and returns how many times it expired
+	static U32 AdvanceTimer(U32& timer, U32 period, U32 cycles);
+
+	struct Square {
+		bool on = false;
+		U8 duty = 0, dutyStep = 0;
+		U16 frequency = 0;
+		U32 timer = 0;
+		Envelope envelope;
+		Length length;
+
+		// Sweep, channel 1 only
+		U8 sweepShift = 0, sweepTime = 0, sweepTimer = 0;
+		bool sweepDecrease = false;
+	};
+	std::array<Square, 2> squares;
+
+	struct Wave {
+		bool on = false, playing = false, doubleBank = false;
+		U8 bank = 0, position = 0;
+		U8 volume = 0;
+		bool forceVolume = false;
+		U16 frequency = 0;
+		U32 timer = 0;
+		Length length { 0, 256 };
+		std::array<std::array<U8, 16>, 2> ram {};
+	} wave;
+
+	struct Noise {
+		bool on = false, narrow = false, high = false;
+		U16 lfsr = 0;
+		U32 period = 8;
+		U32 timer = 0;
+		Envelope envelope;
+		Length length;
+	} noise;
+
+	void RestartSquare(U8 id);
+	void ClockSweep();
+	void ClockFrameSequencer();
+	S16 SquareOutput(U8 id, U32 cycles);
+	S16 WaveOutput(U32 cycles);
+	S16 NoiseOutput(U32 cycles);
+
+	// 512Hz clock for the length counters, sweep and envelopes
+	U32 frameSequencerCycles = 0;
+	U8 frameSequencerStep = 0;
+
+	// SOUNDCNT_L and SOUNDCNT_X
+	U8 volumeRight = 0, volumeLeft = 0;
+	std::array<bool, CHANNELS> enableRight {}, enableLeft {};
+	bool masterEnable = false;
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "int.hpp"
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// Band-limited stereo sample rate converter: a Kaiser windowed-sinc lowpass
+// stored as a polyphase table, interpolated between neighbouring phases.
+// Doesn't depend on the audio backend, so it can also resample offline dumps.
+class Resampler {
+public:
+	static const U32 CHANNELS = 2;
+	// Input frames each output frame is computed from
+	static const U32 TAPS = 32;
+	static const U32 PHASES = 256;
+
+	Resampler(U32 inputRate, U32 outputRate);
+
+	// Converts interleaved stereo frames and appends the result to output. Input is
+	// buffered, so output trails it by TAPS / 2 frames.
+	void Process(const S16* input, size_t frames, std::vector<S16>& output);
+
+	// Produces that fraction more (or, when negative, fewer) output frames than the
+	// nominal rates give, for dynamic rate control
+	void SetRateAdjustment(double adjustment) { step = nominalStep / (1 + adjustment); }
+
+private:
+	float Convolve(const float* samples, const float* phase, const float* nextPhase, float fraction) const;
+
+	// Row p holds the taps for an output frame p / PHASES of the way past the
+	// middle input frame, with one extra row for interpolating past the last phase
+	std::vector<float> coefficients;
+
+	// Input frames not yet consumed, one vector per channel
+	std::array<std::vector<float>, CHANNELS> history;
+	// Position of the next output frame in history, in input frames
+	double position = 0;
+	// Input frames per output frame
+	double nominalStep, step;
+};
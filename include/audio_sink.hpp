@@ -0,0 +1,39 @@
+#pragma once
+#include "int.hpp"
+#include <cstddef>
+
+// Destination of the APU's interleaved stereo output, chosen at startup
+class AudioSink {
+public:
+	virtual ~AudioSink() = default;
+
+	// Rate the sink takes samples at, the APU resamples to it if needed
+	virtual U32 SampleRate() const = 0;
+
+	// Called from the emulation thread
+	virtual void Push(const S16* samples, size_t count) = 0;
+	// Called once when emulation ends, nothing is pushed afterwards. The APU is never
+	// destroyed, so sinks finish here rather than in their destructor.
+	virtual void Close() { }
+
+	// Real time sinks report how many samples are queued and how many they aim to
+	// keep queued, which the APU steers its resampling rate by. Sinks with no
+	// target leave the rate alone.
+	virtual size_t Buffered() const { return 0; }
+	virtual size_t TargetBuffered() const { return 0; }
+};
+
+// Discards everything, for headless runs
+class NullAudioSink : public AudioSink {
+public:
+	NullAudioSink(U32 sampleRate)
+		: sampleRate(sampleRate)
+	{
+	}
+
+	U32 SampleRate() const override { return sampleRate; }
+	void Push(const S16*, size_t) override { }
+
+private:
+	U32 sampleRate;
+};
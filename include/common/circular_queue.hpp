@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include <iostream>
 template <class T, size_t N>
 class CircularQueue {
@@ -53,6 +54,17 @@ public:
 		elems_count++;
 	}
 
+	// Pushes as many of the count values as fit
+	void Push(const T* vals, size_t count)
+	{
+		count = std::min(count, N - elems_count);
+		for (size_t i = 0; i < count; i++) {
+			elems[endIndex] = vals[i];
+			endIndex = (endIndex + 1 == N) ? 0 : endIndex + 1;
+		}
+		elems_count += count;
+	}
+
 	T elems[N] = { 0 };
 
 private:
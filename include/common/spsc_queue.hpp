@@ -0,0 +1,87 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Lock-free queue shared by exactly one producer thread and one consumer thread.
+// Holds up to N - 1 elements.
+template <class T, size_t N>
+class SPSCQueue {
+public:
+	bool IsEmpty() const
+	{
+		return headIndex.load(std::memory_order_acquire) == tailIndex.load(std::memory_order_acquire);
+	}
+
+	size_t Size() const
+	{
+		auto head = headIndex.load(std::memory_order_acquire);
+		auto tail = tailIndex.load(std::memory_order_acquire);
+		return (tail + N - head) % N;
+	}
+
+	// Producer only
+	bool Push(const T& val)
+	{
+		auto tail = tailIndex.load(std::memory_order_relaxed);
+		auto next = Next(tail);
+		if (next == headIndex.load(std::memory_order_acquire))
+			return false;
+
+		elems[tail] = val;
+		tailIndex.store(next, std::memory_order_release);
+		return true;
+	}
+
+	// Producer only, pushes as many of the count values as fit and returns how many did
+	size_t Push(const T* vals, size_t count)
+	{
+		auto tail = tailIndex.load(std::memory_order_relaxed);
+		auto head = headIndex.load(std::memory_order_acquire);
+		count = std::min(count, (head + N - tail - 1) % N);
+
+		// Copy up to the end of the array, then wrap around
+		auto first = std::min(count, N - tail);
+		std::copy_n(vals, first, elems.begin() + tail);
+		std::copy_n(vals + first, count - first, elems.begin());
+		tailIndex.store((tail + count) % N, std::memory_order_release);
+		return count;
+	}
+
+	// Consumer only
+	bool Pop(T& val)
+	{
+		auto head = headIndex.load(std::memory_order_relaxed);
+		if (head == tailIndex.load(std::memory_order_acquire))
+			return false;
+
+		val = elems[head];
+		headIndex.store(Next(head), std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only, pops up to count values and returns how many were popped
+	size_t Pop(T* vals, size_t count)
+	{
+		auto head = headIndex.load(std::memory_order_relaxed);
+		auto tail = tailIndex.load(std::memory_order_acquire);
+		count = std::min(count, (tail + N - head) % N);
+
+		auto first = std::min(count, N - head);
+		std::copy_n(elems.begin() + head, first, vals);
+		std::copy_n(elems.begin(), count - first, vals + first);
+		headIndex.store((head + count) % N, std::memory_order_release);
+		return count;
+	}
+
+private:
+	static size_t Next(size_t index)
+	{
+		return (index + 1) == N ? 0 : index + 1;
+	}
+
+	std::array<T, N> elems {};
+	alignas(64) std::atomic<size_t> headIndex { 0 };
+	alignas(64) std::atomic<size_t> tailIndex { 0 };
+};
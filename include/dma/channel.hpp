@@ -2,8 +2,14 @@
 #include "memory/memory.hpp"
 
 #include "utils.hpp"
+#include <functional>
 
 namespace DMA {
+// Receives a sound DMA's 16 bytes for FIFO A (0) or B (1)
+using FIFOWriteCallback = std::function<void(U8 fifo, const S8* samples, size_t count)>;
+// Receives HBlank DMA units bound for the LCD registers, the n-th for address + n * step
+using LCDWriteCallback = std::function<void(const AccessSize& size, U32 address, S32 step, const U32* values, U32 count)>;
+
 class Channel {
 public:
 	Channel(std::int_fast8_t id, std::shared_ptr<Memory> memory_);
@@ -14,8 +20,12 @@ public:
 	void CalculateTransferSteps();
 	void UpdateDetails(U16 value);
 
-	void DoTransferStep();
-	void DoSoundTransfer();
+	// Internal cycles spent before the first unit is transferred
+	U32 StartupCycles() const;
+	// LCD register writes go through lcdWrite instead of memory when it is set. A bulk
+	// copy charges at most maxCycles, unless a single unit already costs more.
+	void DoTransferStep(const LCDWriteCallback& lcdWrite, U32 maxCycles);
+	void DoSoundTransfer(const FIFOWriteCallback& fifoWrite);
 
 	const std::int_fast8_t ID;
 	const U32 SAD;
@@ -32,14 +42,18 @@ public:
 	U16 irqAtEnd;
 	U16 transferType;
 	U16 transferSize;
-	U16 srcStep;
-	U16 destStep;
+	// Signed, so decrementing addresses step backwards instead of wrapping forwards
+	S16 srcStep;
+	S16 destStep;
 	U16 destAddrCtl;
 	U16 srcAddrCtl;
 
 	U32 dest;
 
 private:
+	// Moves units from plain memory into the LCD registers through lcdWrite, if that's where they go
+	bool TransferLCDRegisters(const LCDWriteCallback& lcdWrite, const AccessSize& size, U32 units);
+
 	std::shared_ptr<Memory> memory;
 
 	U32 source;
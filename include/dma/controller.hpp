@@ -3,13 +3,15 @@
 #include "dma/channel.hpp"
 #include "dma/dma_io_registers.hpp"
 #include "memory/memory.hpp"
+#include "system_clock.hpp"
 #include <array>
 
 namespace DMA {
 class Controller : public DMAIORegisters {
 public:
-	Controller(std::shared_ptr<Memory> memory)
-		: memory(memory){};
+	Controller(std::shared_ptr<SystemClock> clock, std::shared_ptr<Memory> memory)
+		: clock(clock)
+		, memory(memory) {};
 
 	enum Event { IMMEDIATE,
 		VBLANK,
@@ -18,10 +20,17 @@ public:
 		FIFOA,
 		FIFOB };
 
+	// Runs the next step of the highest priority active channel, DMA0 first
 	void Execute();
-	bool IsActive();
+	bool IsActive() const { return activeChannels != 0; }
 	void CntHUpdateCallback(U8 id, U16 value);
 	void EventCallback(Event event, bool start);
+	// Sound DMA hands its data straight to the APU's FIFOs when set
+	void SetFIFOWriteCallback(FIFOWriteCallback callback) { fifoWrite = callback; }
+	// HBlank DMA into the LCD registers writes straight to the PPU when set
+	void SetLCDWriteCallback(LCDWriteCallback callback) { lcdWrite = callback; }
+	// Cycles until the PPU next changes state; bulk copies end before then when set
+	void SetCycleBudgetCallback(std::function<U32()> callback) { cycleBudget = callback; }
 
 	U32 Read(const AccessSize& size,
 		U32 address,
@@ -32,8 +41,16 @@ public:
 		const Sequentiality&) override;
 
 private:
+	void SetActive(U8 id, bool active);
+
+	std::shared_ptr<SystemClock> clock;
 	std::shared_ptr<Memory> memory;
-	bool controllerActive = false;
+	// Bit n set while channel n is active, and while its startup cycles are still owed
+	U8 activeChannels = 0;
+	U8 startingChannels = 0;
+	FIFOWriteCallback fifoWrite;
+	LCDWriteCallback lcdWrite;
+	std::function<U32()> cycleBudget;
 	std::unique_ptr<Channel> channels[4] = { std::make_unique<Channel>(0, memory),
 		std::make_unique<Channel>(1, memory),
 		std::make_unique<Channel>(2, memory),
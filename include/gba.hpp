@@ -18,6 +18,15 @@ struct GBAConfig {
 	std::string romPath;
 	Screen& screen;
 	Joypad& joypad;
+	// Draw scanlines on a separate thread while the CPU runs
+	bool threadedRender = false;
+	PPU::RenderPolicy renderPolicy = PPU::RenderPolicy::Always;
+	// Used by RenderPolicy::EveryNthFrame
+	U32 frameInterval = 1;
+	// No sink discards audio
+	std::shared_ptr<AudioSink> audioSink = nullptr;
+	// Stops after this many frames, 0 runs until escape is pressed
+	U32 frameLimit = 0;
 };
 
 class GBA {
@@ -28,17 +37,19 @@ public:
 		, memory(std::make_shared<Memory>(sysClock, cfg.biosPath, cfg.romPath,
 			  cfg.joypad))
 		, cpu(std::make_shared<ARM7TDMI::CPU>(sysClock, memory))
-		, dma(std::make_shared<DMA::Controller>(memory))
+		, dma(std::make_shared<DMA::Controller>(sysClock, memory))
 		, ppu(std::make_shared<PPU>(
 			  memory, cfg.screen, std::static_pointer_cast<IRQChannel>(cpu),
 			  std::bind(&DMA::Controller::EventCallback, dma,
 				  DMA::Controller::Event::HBLANK, std::placeholders::_1),
 			  std::bind(&DMA::Controller::EventCallback, dma,
-				  DMA::Controller::Event::VBLANK, std::placeholders::_1)))
+				  DMA::Controller::Event::VBLANK, std::placeholders::_1),
+			  cfg.threadedRender))
 		, debugger(memory)
-		, apu(std::make_shared<APU>(
+		, apu(std::make_shared<APU>(sysClock,
 			  std::bind(&DMA::Controller::EventCallback, dma, DMA::Controller::Event::FIFOA, true),
-			  std::bind(&DMA::Controller::EventCallback, dma, DMA::Controller::Event::FIFOB, true)))
+			  std::bind(&DMA::Controller::EventCallback, dma, DMA::Controller::Event::FIFOB, true),
+			  cfg.audioSink ? cfg.audioSink : std::make_shared<NullAudioSink>(APU::SAMPLE_RATE)))
 		, timers(std::make_shared<Timers>(
 			  std::static_pointer_cast<IRQChannel>(cpu),
 			  std::bind(&APU::FIFOUpdate, apu, std::placeholders::_1)))
@@ -47,6 +58,13 @@ public:
 
 		memory->SetDebugWriteCallback(std::bind(&Debugger::NotifyMemoryWrite,
 			&debugger, std::placeholders::_1));
+		memory->SetOAMWriteCallback(std::bind(&PPU::OAMWriteCallback,
+			ppu, std::placeholders::_1, std::placeholders::_2));
+		dma->SetLCDWriteCallback(std::bind(&PPU::WriteRegisterBlock, ppu, std::placeholders::_1,
+			std::placeholders::_2, std::placeholders::_3, std::placeholders::_4, std::placeholders::_5));
+		dma->SetFIFOWriteCallback(std::bind(&APU::FIFOWrite,
+			apu, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+		dma->SetCycleBudgetCallback(std::bind(&PPU::CyclesToNextState, ppu));
 
 		auto ioRegisters = std::make_shared<IORegisters>(
 			std::static_pointer_cast<TimersIORegisters>(timers),
@@ -56,14 +74,22 @@ public:
 			std::static_pointer_cast<APUIORegisters>(apu));
 		memory->AttachIORegisters(ioRegisters);
 		memory->AttachIRIORegisters(std::static_pointer_cast<IRIORegisters>(cpu));
+		ppu->SetRenderPolicy(cfg.renderPolicy, cfg.frameInterval);
 		cpu->Reset();
 	};
 
-	~GBA() { memory->Save(); }
+	// The components hold each other through shared_ptr cycles and are never destroyed,
+	// so anything that must happen on exit is done here
+	~GBA()
+	{
+		memory->Save();
+		ppu->StopRenderThread();
+		apu->Close();
+	}
 
 	void run()
 	{
-		while (!cfg.joypad.esc) {
+		while (!cfg.joypad.esc && !(cfg.frameLimit && ppu->FramesCompleted() >= cfg.frameLimit)) {
 #ifndef NDEBUG
 			debugger.CheckForBreakpoint(cpu->ViewState());
 #endif
@@ -74,9 +100,11 @@ public:
 			}
 
 			auto ticks = sysClock->SinceLastCheck();
+			// The APU first, so FIFO samples popped by timer overflows are stamped
+			// with the end of this step like the overflows themselves
 			ppu->Execute(ticks);
-			timers->Update(ticks);
 			apu->Tick(ticks);
+			timers->Update(ticks);
 		}
 	};
 
@@ -50,4 +50,10 @@ public:
 	static bool leftBump;
 	static bool bp;
 	static bool esc;
+};
+
+// No keys are ever pressed, for headless runs
+class NullJoypad : public Joypad {
+public:
+	void keyUpdate() override { }
 };
\ No newline at end of file
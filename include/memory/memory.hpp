@@ -19,6 +19,33 @@
 
 class Memory : public ReadWriteInterface {
 public:
+	struct DisplayMemory {
+		std::array<U8, PRAM_SIZE> pram {};
+		std::array<U8, VRAM_SIZE> vram {};
+		std::array<U8, OAM_SIZE> oam {};
+
+		// Display memory is also addressed in fixed size blocks; PRAM first, then VRAM and OAM
+		static const U32 BLOCK_SIZE = 0x100;
+		static const U32 PRAM_BLOCKS = PRAM_SIZE / BLOCK_SIZE,
+						 VRAM_BLOCKS = VRAM_SIZE / BLOCK_SIZE,
+						 OAM_BLOCKS = OAM_SIZE / BLOCK_SIZE,
+						 BLOCKS = PRAM_BLOCKS + VRAM_BLOCKS + OAM_BLOCKS;
+		static const U32 OAM_FIRST_BLOCK = PRAM_BLOCKS + VRAM_BLOCKS;
+
+		U8* Block(U32 block)
+		{
+			if (block < PRAM_BLOCKS)
+				return pram.data() + (block * BLOCK_SIZE);
+			if (block < OAM_FIRST_BLOCK)
+				return vram.data() + ((block - PRAM_BLOCKS) * BLOCK_SIZE);
+			return oam.data() + ((block - OAM_FIRST_BLOCK) * BLOCK_SIZE);
+		}
+		const U8* Block(U32 block) const
+		{
+			return const_cast<DisplayMemory*>(this)->Block(block);
+		}
+	};
+
 	Memory(std::shared_ptr<SystemClock> clock,
 		std::string biosPath,
 		std::string romPath,
@@ -37,6 +64,23 @@ public:
 		U32 value,
 		const Sequentiality& type) override;
 
+	// Charges the bus cycles of an access without performing it, for transfers that
+	// move the data themselves
+	void TickAccess(const AccessSize& size, U32 address, const Sequentiality& seq) { Tick(size, address >> 24, seq); }
+	// Cycles of one sequential read from source and write to dest
+	U32 TransferTicks(const AccessSize& size, U32 dest, U32 source) { return AccessTicks(size, source >> 24, SEQ) + AccessTicks(size, dest >> 24, SEQ); }
+
+	// Copies count units of size from source to dest as one operation, stepping each
+	// address by its step (in bytes, possibly 0 or negative) per unit, and charges all
+	// of the sequential access cycles at once. Only plain memory regions are handled and
+	// the transfer must stay inside them; returns false without doing anything otherwise.
+	bool BlockTransfer(const AccessSize& size, U32 dest, S32 destStep, U32 source, S32 srcStep, U32 count);
+	// BlockTransfer for destinations that store the values themselves, such as IO registers:
+	// the source is read into values, which must hold count units, and handed to write.
+	// Cycles and write notifications are the same as for a copy into memory.
+	bool BlockTransfer(const AccessSize& size, U32 dest, S32 destStep, U32 source, S32 srcStep, U32 count,
+		U32* values, const std::function<void(const U32* values)>& write);
+
 	U8 GetByte(const U32& address);
 	U16 GetHalf(const U32& address);
 	U32 GetWord(const U32& address);
@@ -47,6 +91,13 @@ public:
 	void SetIOWriteCallback(U32 address,
 		std::function<void(U32)> callback);
 	void SetDebugWriteCallback(std::function<void(U32)> callback);
+	void SetOAMWriteCallback(std::function<void(U32, AccessSize)> callback);
+
+	// Direct view of palette, video and object memory for the renderer
+	const DisplayMemory& GetDisplayMemory() { return mem.disp; }
+	// Records which display memory blocks are written, for mirroring them on another thread
+	void SetDisplayWriteTracking(bool enable) { trackDisplayWrites = enable; }
+	void ConsumeDirtyDisplayBlocks(const std::function<void(U32)>& callback);
 
 private:
 	std::shared_ptr<SystemClock> clock;
@@ -55,16 +106,28 @@ private:
 
 	std::string FindBackupID(size_t length);
 
+	// Backing array of the region the address is in, if it is plain memory without side effects
+	U8* PlainRegion(U32 address, U32& mask, U32& size);
+
+	// Charges the cycles of a block transfer and sends the notifications of its writes
+	void FinishBlockTransfer(const AccessSize& size, U32 dest, S32 destStep, U32 source, U32 count);
+	void MarkDisplayWrite(U32 firstBlock, U32 offset, const AccessSize& size);
+	void MarkDisplayRange(U32 firstBlock, U32 offset, U32 bytes);
 	void Tick(const AccessSize& size, const U32& page, const Sequentiality& seq);
-	void TickBySize(const AccessSize& size,
+	U32 AccessTicks(const AccessSize& size, const U32& page, const Sequentiality& seq);
+	static U32 TicksBySize(const AccessSize& size,
 		const U32& ticks8,
 		const U32& ticks16,
 		const U32& ticks32);
 	// https://problemkaputt.de/gbatek.htm#gbamemorymap
 	std::function<void(U32)> PublishWriteCallback;
+	std::function<void(U32, AccessSize)> OAMWriteCallback;
 	Joypad& joypad;
 	std::shared_ptr<IRIORegisters> irio;
 
+	bool trackDisplayWrites = false;
+	std::array<std::uint64_t, (DisplayMemory::BLOCKS + 63) / 64> dirtyDisplayBlocks {};
+
 	struct MemoryMap {
 		struct {
 			std::array<U8, BIOS_SIZE> bios {};
@@ -73,11 +136,7 @@ private:
 			std::shared_ptr<IORegisters> io {};
 		} gen;
 
-		struct {
-			std::array<U8, PRAM_SIZE> pram {};
-			std::array<U8, VRAM_SIZE> vram {};
-			std::array<U8, OAM_SIZE> oam {};
-		} disp;
+		DisplayMemory disp;
 
 		struct {
 			std::array<U8, ROM_SIZE> rom {};
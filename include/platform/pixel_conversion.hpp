@@ -0,0 +1,7 @@
+#pragma once
+#include "int.hpp"
+#include <cstddef>
+
+// Converts GBA BGR555 colours to RGBA8888 bytes with opaque alpha, expanding
+// each 5 bit channel to the full 8 bit range
+void ConvertBGR555ToRGBA8888(const U16* src, U8* dest, std::size_t count);
@@ -1,49 +1,67 @@
 #pragma once
 
-#include "common/circular_queue.hpp"
+#include "audio_sink.hpp"
+#include "common/spsc_queue.hpp"
 #include "int.hpp"
 #include "utils.hpp"
+#include <algorithm>
 #include <SFML/Audio.hpp>
 
-class AudioStream : public sf::SoundStream {
+// Plays through the default audio device from construction
+class AudioStream : public AudioSink, public sf::SoundStream {
 public:
-	static const U32 SAMPLE_FREQ = 32768;
-	AudioStream()
+	// Device rate, the APU's output is resampled to it
+	static const U32 SAMPLE_FREQ = 48000;
+	static const U32 CHANNELS = 2;
+
+	// Latency is how much audio, in milliseconds, the stream tries to keep queued
+	AudioStream(U32 latency)
+		: targetBuffered(std::clamp<size_t>((SAMPLE_FREQ * CHANNELS * latency) / 1000, MIN_CHUNK_SIZE * 2, BUFFER_SIZE / 2) & ~size_t { 1 })
+		, chunkSize(targetBuffered / 2)
 	{
-		initialize(2u, SAMPLE_FREQ);
+		initialize(CHANNELS, SAMPLE_FREQ);
+		play();
 	}
-	bool playing = false;
-	void PushOne(const S16& value)
+	~AudioStream() override { stop(); }
+	void Close() override { stop(); }
+
+	U32 SampleRate() const override { return SAMPLE_FREQ; }
+	// Samples that don't fit are dropped
+	void Push(const S16* values, size_t count) override
 	{
-		samples.Push(value);
+		samples.Push(values, count);
 	}
 
+	// Samples queued but not yet handed to SFML
+	size_t Buffered() const override { return samples.Size(); }
+	size_t TargetBuffered() const override { return targetBuffered; }
+
 	static const U32 BUFFER_SIZE = SAMPLE_FREQ / 2;
+	// Smallest chunk handed to SFML, ~5ms
+	static const U32 MIN_CHUNK_SIZE = 512;
 
 private:
+	// The queue is kept near targetBuffered by the producer, so only an underrun
+	// falls back to silence
 	virtual bool onGetData(Chunk& data)
 	{
-		if (samples.Size() < (BUFFER_SIZE / 2)) {
+		data.sampleCount = samples.Pop(buffer.data(), chunkSize);
+		data.samples = buffer.data();
+		if (data.sampleCount == 0) {
 			data.samples = emptyBuffer.data();
-			data.sampleCount = BUFFER_SIZE / 10;
-			return true;
-		} else {
-			data.sampleCount = (BUFFER_SIZE / 2);
-			U16 i = 0;
-			while (samples.IsEmpty() == false && i < (BUFFER_SIZE / 2u)) {
-				buffer[i] = samples.Pop();
-				i++;
-			}
-			data.samples = buffer.data();
-			return true;
+			data.sampleCount = chunkSize;
 		}
+		return true;
 	}
 
 	virtual void onSeek(sf::Time)
 	{
 	}
 
+	size_t targetBuffered, chunkSize;
+
 	std::array<sf::Int16, BUFFER_SIZE> emptyBuffer = { 0 };
 	std::array<sf::Int16, BUFFER_SIZE> buffer = {};
-	CircularQueue<sf::Int16, BUFFER_SIZE> samples;
+	// Filled by the emulation thread, drained by SFML's audio thread
+	SPSCQueue<sf::Int16, BUFFER_SIZE> samples;
 };
\ No newline at end of file
@@ -4,19 +4,34 @@
 #include "platform/sfml/joypad.hpp"
 #include <SFML/Graphics.hpp>
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 class WindowSFML : public Screen {
 public:
 	WindowSFML();
-	void render(const Framebuffer& fb) override;
+	~WindowSFML() override;
+	void render() override;
+	void poll() override;
 
 	JoypadSFML joypad;
 
 private:
-	void translateFramebuffer(const Framebuffer& fb);
+	void translateFramebuffer(const Framebuffer& fb, std::array<sf::Uint8, 4 * SCREEN_TOTAL>& out);
+	void ConvertThreadLoop();
 
 	std::chrono::high_resolution_clock::time_point begin = std::chrono::high_resolution_clock::now();
-	std::array<sf::Uint8, 4 * SCREEN_TOTAL> sfFramebuffer;
+	std::chrono::steady_clock::time_point nextFrame = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::duration frameTime = std::chrono::microseconds(1000000 / 60);
+	// Frames are converted to RGBA on convertThread while the next one is emulated, and
+	// uploaded by the following render(). The thread writes the buffer not last published.
+	std::array<std::array<sf::Uint8, 4 * SCREEN_TOTAL>, 2> sfFramebuffers;
+	std::thread convertThread;
+	std::mutex convertMutex;
+	std::condition_variable convertWake;
+	bool convertRequested = false, converted = false, stopConverting = false;
+	U8 convertedIndex = 1;
 	sf::Sprite b;
 	sf::RenderWindow window;
 	sf::Texture background;
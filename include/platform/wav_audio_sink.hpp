@@ -0,0 +1,22 @@
+#pragma once
+#include "audio_sink.hpp"
+#include <fstream>
+#include <string>
+
+// Streams 16 bit stereo PCM to a WAV file, the sizes in the header are filled in on close
+class WavAudioSink : public AudioSink {
+public:
+	WavAudioSink(const std::string& path, U32 sampleRate);
+	~WavAudioSink() override { Close(); }
+
+	U32 SampleRate() const override { return sampleRate; }
+	void Push(const S16* samples, size_t count) override;
+	void Close() override;
+
+private:
+	void WriteHeader();
+
+	std::ofstream out;
+	U32 sampleRate;
+	U32 dataBytes = 0;
+};
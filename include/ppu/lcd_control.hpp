@@ -7,6 +7,7 @@ struct DispCnt {
 	DispCnt(U16 value)
 		: bgMode { (U8)BIT_RANGE(value, 0, 2) }
 		, frameSelect { (U8)BIT_RANGE(value, 4, 4) }
+		, hBlankIntervalFree { (bool)BIT_RANGE(value, 5, 5) }
 		, objMapping { (U8)BIT_RANGE(value, 6, 6) }
 		, forcedBlank { (bool)BIT_RANGE(value, 7, 7) }
 		, screenDisplay { (U8)BIT_RANGE(value, 8, 11) }
@@ -19,6 +20,7 @@ struct DispCnt {
 
 	U8 bgMode;
 	U8 frameSelect;
+	bool hBlankIntervalFree;
 	U8 objMapping;
 	bool forcedBlank;
 	U8 screenDisplay;
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "int.hpp"
+#include "ppu/obj_attributes.hpp"
+#include "screen.hpp"
+#include <array>
+#include <cstdint>
+
+// Decoded copy of OAM, kept up to date from OAM writes so the renderer never
+// has to re-read and re-parse attributes.
+// https://problemkaputt.de/gbatek.htm#lcdobjoamattributes
+class OAMCache {
+public:
+	static const U32 ENTRIES = 128, AFFINE_GROUPS = 32;
+	static const U16 MAX_X = 512, MAX_Y = 256;
+
+	using LineMask = std::array<std::uint64_t, 2>;
+
+	OAMCache();
+
+	// Re-decodes the entry (or affine parameter) containing the halfword at the OAM offset
+	void Update(U32 offset, U16 value);
+
+	// Set bits are the OAM indices of the enabled objects whose bounds intersect line y
+	const LineMask& ObjectsOnLine(U16 y) const { return lineIndex[y]; }
+
+	// Attributes
+	std::array<U16, ENTRIES> x {};
+	std::array<U8, ENTRIES> y {};
+	std::array<U8, ENTRIES> width {};
+	std::array<U8, ENTRIES> height {};
+	std::array<U8, ENTRIES> boundsWidth {};
+	std::array<U8, ENTRIES> boundsHeight {};
+	std::array<bool, ENTRIES> enabled {};
+	std::array<bool, ENTRIES> affine {};
+	std::array<bool, ENTRIES> horizontalFlip {};
+	std::array<bool, ENTRIES> verticalFlip {};
+	std::array<bool, ENTRIES> mosaic {};
+	std::array<U8, ENTRIES> mode {};
+	std::array<U8, ENTRIES> colorDepth {};
+	std::array<U8, ENTRIES> affineGroup {};
+	std::array<U16, ENTRIES> tileNumber {};
+	std::array<U8, ENTRIES> priority {};
+	std::array<U8, ENTRIES> paletteNumber {};
+
+	// Affine parameters, 8.8 fixed point
+	std::array<S16, AFFINE_GROUPS> pa {}, pb {}, pc {}, pd {};
+
+private:
+	void Decode(U8 entry);
+	void SetIndexed(U8 entry, bool set);
+
+	std::array<std::array<U16, 3>, ENTRIES> raw {};
+	std::array<bool, ENTRIES> indexed {};
+	std::array<LineMask, Screen::SCREEN_HEIGHT> lineIndex {};
+};
@@ -1,52 +1,54 @@
-
+#pragma once
 #include "int.hpp"
 #include "utils.hpp"
+#include <algorithm>
+#include <array>
 
-struct Pixel {
-	Pixel(U16 value)
-		: r(BIT_RANGE(value, 0, 4))
-		, g(BIT_RANGE(value, 5, 9))
-		, b(BIT_RANGE(value, 10, 14))
-	{
-	}
+// Colour special effects on BGR555 values
+// https://problemkaputt.de/gbatek.htm#lcdiocolorspecialeffects
+class ColorEffects {
+public:
+	static constexpr U8 MAX_COEFFICIENT = 16, COEFFICIENT_LEVELS = MAX_COEFFICIENT + 1;
+	using ChannelTable = std::array<U8, 32>;
 
-	void Blend(const Pixel& other, U8 eva, U8 evb)
-	{
-		r = (r * eva + other.r * evb) / 16;
-		if (r > 31) {
-			r = 31;
-		}
-		g = (g * eva + other.g * evb) / 16;
-		if (g > 31) {
-			g = 31;
-		}
-		b = (b * eva + other.b * evb) / 16;
-		if (b > 31) {
-			b = 31;
-		}
-	}
+	ColorEffects() { SetBrightness(0); }
 
-	void BrightnessIncrease(U8 evy)
+	// Coefficients are 1.4 fixed point, values above 16 behave as 16
+	void SetAlpha(U8 eva_, U8 evb_)
 	{
-		r = r + ((31 - r) * evy) / 16;
-		g = g + ((31 - g) * evy) / 16;
-		b = b + ((31 - b) * evy) / 16;
+		eva = std::min(eva_, MAX_COEFFICIENT);
+		evb = std::min(evb_, MAX_COEFFICIENT);
 	}
 
-	void BrightnessDecrease(U8 evy)
+	void SetBrightness(U8 evy);
+
+	// Each channel is first * EVA + second * EVB, saturated to 31. The channels are
+	// spread with enough space between them to do all three in one multiply.
+	U16 Blend(U16 first, U16 second) const
 	{
-		r = r - (r * evy / 16);
-		g = g - (g * evy / 16);
-		b = b - (b * evy / 16);
+		U32 sum = ((Spread(first) * eva + Spread(second) * evb) >> 4) & SPREAD_RESULT_MASK;
+		U32 saturated = (sum >> 5) & SPREAD_LOW_BITS;
+		return Pack(sum | (saturated * 31));
 	}
 
-	U16 Value()
+	U16 Brighten(U16 color) const { return Lookup(*brighten, color); }
+	U16 Darken(U16 color) const { return Lookup(*darken, color); }
+
+private:
+	// Red in bits 0-4, blue in 10-14, green in 21-25
+	static U32 Spread(U16 color) { return (color & 0x7C1F) | ((color & 0x03E0) << 16); }
+	static U16 Pack(U32 spread) { return (spread & 0x7C1F) | ((spread >> 16) & 0x03E0); }
+	static constexpr U32 SPREAD_RESULT_MASK = 0x07E0FC3F, SPREAD_LOW_BITS = 0x00200401;
+
+	static U16 Lookup(const ChannelTable& table, U16 color)
 	{
-		U16 v = r + (g << 5) + +(b << 10);
-		return v;
+		return table[BIT_RANGE(color, 0, 4)]
+			| (table[BIT_RANGE(color, 5, 9)] << 5)
+			| (table[BIT_RANGE(color, 10, 14)] << 10);
 	}
 
-	U16 r;
-	U16 g;
-	U16 b;
-};
\ No newline at end of file
+	U32 eva = 0, evb = 0;
+	// Per channel results for the current EVY
+	const ChannelTable* brighten;
+	const ChannelTable* darken;
+};
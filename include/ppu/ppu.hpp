@@ -1,22 +1,25 @@
 #pragma once
 
 #include "arm7tdmi/irq_channel.hpp"
+#include "common/spsc_queue.hpp"
 #include "memory/memory.hpp"
 #include "memory/regions.hpp"
 #include "ppu/bg_control_info.hpp"
 #include "ppu/blend_control.hpp"
 #include "ppu/lcd_control.hpp"
 #include "ppu/lcd_io_registers.hpp"
-#include "ppu/obj_attributes.hpp"
+#include "ppu/oam_cache.hpp"
+#include "ppu/pixel.hpp"
 #include "ppu/tile_info.hpp"
 #include "ppu/window.hpp"
 #include "screen.hpp"
 #include "utils.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
 
-#include <optional>
-#include <vector>
-
-#define GET_HALF(A) (U16) Read(Half, A, FREE)
 class PPU : public LCDIORegisters {
 	enum State { Visible,
 		HBlank,
@@ -26,16 +29,16 @@ public:
 	PPU(std::shared_ptr<Memory> memory_, Screen& screen_,
 		std::shared_ptr<IRQChannel> irqChannel_,
 		std::function<void(bool)> HBlankCallback_,
-		std::function<void(bool)> VBlankCallback_)
-		: memory(memory_)
-		, screen(screen_)
-		, irqChannel(irqChannel_)
-		, HBlankCallback(HBlankCallback_)
-		, VBlankCallback(VBlankCallback_)
-	{
-	}
+		std::function<void(bool)> VBlankCallback_,
+		bool threadedRender = false);
+	~PPU();
+	// Finishes the queued lines and joins the render thread, if there is one. The PPU
+	// is shared with the IO registers, so the owner stops it rather than the destructor.
+	void StopRenderThread();
 
 	void Execute(U32 ticks);
+	// Cycles left before Execute next changes state, and may raise or drop a DMA trigger
+	U32 CyclesToNextState() const;
 
 	U32 Read(const AccessSize& size,
 		U32 address,
@@ -45,15 +48,35 @@ public:
 		U32 value,
 		const Sequentiality&) override;
 
+	void OAMWriteCallback(U32 offset, const AccessSize& size);
+	// HBlank DMA into the LCD registers, skipping the IO register dispatch. The n-th
+	// value is written to address + n * step.
+	void WriteRegisterBlock(const AccessSize& size, U32 address, S32 step, const U32* values, U32 count);
+
+	// Which frames are drawn and presented; register, IRQ and DMA timing is the same either way
+	enum class RenderPolicy { Always,
+		EveryNthFrame,
+		Never };
+	void SetRenderPolicy(RenderPolicy policy, U32 interval = 1);
+	// Frames that have reached VBlank, drawn or not
+	U32 FramesCompleted() const { return framesCompleted; }
+
 private:
-	using OptPixel = std::optional<U16>;
+	// Render only instance drawing from a mirror of display memory on the render thread
+	PPU(const Memory::DisplayMemory& disp_, Screen& screen_);
+
+	// Layer pixels are BGR555 colours with bit 15 (unused by the hardware)
+	// repurposed as the transparency flag
+	using PackedPixel = U16;
+	static const PackedPixel TRANSPARENT_PIXEL = 0x8000;
+	static bool IsOpaque(const PackedPixel& pixel) { return !(pixel & TRANSPARENT_PIXEL); }
 
 	struct Mosaic {
 		U8 bgHSize;
 		U8 bgVSize;
 		U8 objHSize;
 		U8 objVSize;
-	} mosaic;
+	} mosaic { 1, 1, 1, 1 };
 
 	// State Management
 	void ToHBlank();
@@ -63,25 +86,81 @@ private:
 	U16 GetDispStat(U8 bit);
 	void UpdateDispStat(U8 bit, bool set);
 	U16 IncrementVCount();
+	void PresentFrame();
+
+	// Render Policy
+	bool DrawNextFrame();
+	RenderPolicy renderPolicy = RenderPolicy::Always;
+	U32 frameInterval = 1, frameCount = 0;
+	U32 framesCompleted = 0;
+	bool drawFrame = true;
+
+	// Threaded Rendering
+	struct RenderCommand {
+		enum Type { DisplayBlock,
+			Line,
+			Stop } type;
+
+		// DisplayBlock
+		U32 block;
+		std::array<U8, Memory::DisplayMemory::BLOCK_SIZE> data;
+
+		// Line
+		std::array<U8, LCD_IO_SIZE> lcdRegisters;
+		std::array<S32, 2> bgXRef, bgYRef;
+	};
+	static const size_t RENDER_QUEUE_SIZE = 1024;
+
+	void QueueLine();
+	void PushRenderCommand(const RenderCommand& command);
+	void WakeRenderThread();
+	void RenderThreadLoop();
+	void ApplyLineSnapshot(const RenderCommand& command);
+
+	std::unique_ptr<Memory::DisplayMemory> workerDisp;
+	std::unique_ptr<PPU> renderer;
+	std::unique_ptr<SPSCQueue<RenderCommand, RENDER_QUEUE_SIZE>> renderQueue;
+	// Lines queued but not yet drawn by the render thread
+	std::atomic<U32> linesPending { 0 };
+	// The render thread sleeps on this while the queue is empty
+	std::mutex renderMutex;
+	std::condition_variable renderWake;
+	std::thread renderThread;
 
 	// Draw Control
-	void MergeRows(std::vector<uint8_t>& bgOrder);
+	void MergeRows();
 	void DrawLine();
 	const Window& GetActiveWindow(U16 x, U16 y);
 	uint8_t GetLayerPriority(uint8_t layer);
-	std::vector<uint8_t> GetBGDrawOrder(std::vector<uint8_t> layers,
-		uint8_t screenDisplay);
+	void UpdateBGDrawOrder();
+	void ApplyHorizontalMosaic(std::array<PackedPixel, Screen::SCREEN_WIDTH>& row, U8 size);
 
-	BGControlInfo bgCnt[4] = { BGControlInfo(0, 0), BGControlInfo(0, 0), BGControlInfo(0, 0), BGControlInfo(0, 0) };
+	BGControlInfo bgCnt[4] = { BGControlInfo(0, 0), BGControlInfo(1, 0), BGControlInfo(2, 0), BGControlInfo(3, 0) };
 	DispCnt dispCnt { 0 };
 
-	// Objects
-	void DrawObjects();
-	void InitTempSprite(ObjAttributes objAttrs);
-	void DrawObject(ObjAttributes objAttrs);
-	void SetObjPixel(OptPixel& pixel, U32 fbPos, U8 objectTransparency, U16 prio);
+	// Decoded copies of the registers read while drawing, refreshed on every write
+	void DecodeRegister(U32 address);
+	U16 vCount = 0;
+	std::array<U16, 4> bgHOffset {}, bgVOffset {};
+	// BG2/BG3 affine parameters, 8.8 fixed point
+	std::array<S16, 2> bgPA {}, bgPB {}, bgPC {}, bgPD {};
 
-	std::array<OptPixel, 64 * 64> tempSprite = {};
+	// Enabled backgrounds of the current mode, front to back, refreshed on DISPCNT/BGxCNT writes
+	std::array<U8, 4> bgOrder {};
+	U8 bgOrderCount = 0;
+
+	// Objects
+	void DrawObjects(U16 y);
+	void EvaluateLineObjects(U16 y);
+	void DrawObject(U8 entry, U16 y);
+	void DrawAffineObject(U8 entry, U16 y);
+	void SetObjPixel(const PackedPixel& pixel, U16 x, U8 objMode, U16 prio, bool objMosaic);
+	void ApplyObjMosaic();
+
+	// OAM indices of the objects intersecting the line being drawn, in OAM order
+	std::array<U8, 128> lineObjects {};
+	U8 lineObjectCount = 0;
+	OAMCache oamCache;
 
 	// Text Mode
 	void TextBGLine(const uint32_t& BG_ID);
@@ -91,9 +170,16 @@ private:
 
 	// Rot Scale Mode
 	void RotScaleBGLine(const U32& BG_ID);
+	void GetAffineLineReference(const U32& BG_ID, S32& refx, S32& refy);
+	void ReloadAffineReference(U8 affineId);
+	void StepAffineReferences();
+	// Internal reference point registers, advanced by PB/PD after every line
 	std::array<S32, 2> bgXRef = {}, bgYRef = {};
-	U8 eva, evb, evy;
 	BldCnt bldCnt;
+	ColorEffects colorEffects;
+
+	// Bitmap Modes
+	void BitmapBGLine(U8 bgMode);
 
 	// Draw Utils
 
@@ -103,12 +189,15 @@ private:
 	U16 GetBgColorFromPalette(const U8& colorID,
 		bool obj = false);
 
-	void SetSFXPixel(OptPixel& firstPrioPixel, OptPixel& secondPrioPixel, U16& dest, BldCnt::ColorSpecialEffect effect);
+	void SetSFXPixel(PackedPixel firstPrioPixel, PackedPixel secondPrioPixel, U16& dest, BldCnt::ColorSpecialEffect effect);
 
+	// Tiles past the end of VRAM read as transparent
 	template <typename T>
 	void FetchDecode8BitPixel(U32 address, T& dest, bool obj)
 	{
-		auto pixelPalette = memory->GetByte(address);
+		if (address - VRAM_START >= VRAM_SIZE)
+			return;
+		auto pixelPalette = disp.vram[address - VRAM_START];
 		if (pixelPalette != 0) {
 			dest = GetBgColorFromPalette(pixelPalette, obj);
 		}
@@ -117,7 +206,9 @@ private:
 	template <typename T>
 	void FetchDecode4BitPixel(U32 address, T& dest, U8 paletteNumber, bool evenPixel, bool obj)
 	{
-		auto pixelPalette = memory->GetByte(address);
+		if (address - VRAM_START >= VRAM_SIZE)
+			return;
+		auto pixelPalette = disp.vram[address - VRAM_START];
 		if (evenPixel) {
 			pixelPalette = BIT_RANGE(pixelPalette, 0, 3);
 		} else {
@@ -130,6 +221,7 @@ private:
 	}
 
 	std::shared_ptr<Memory> memory;
+	const Memory::DisplayMemory& disp;
 	Screen& screen;
 	std::shared_ptr<IRQChannel> irqChannel;
 	std::function<void(bool)> HBlankCallback;
@@ -140,18 +232,23 @@ private:
 	std::array<Window, 4> windows {};
 
 	struct ObjPixel {
-		OptPixel pixel;
-		U16 prio;
+		PackedPixel pixel;
+		U8 prio;
 		bool transparency;
 		bool mask;
+		bool mosaic;
 	};
 
-	const ObjPixel emptyObjPixel { {}, 5, false, false };
+	const ObjPixel emptyObjPixel { TRANSPARENT_PIXEL, 5, false, false, false };
 
-	std::array<ObjPixel, Screen::SCREEN_TOTAL> objFb;
-	std::array<std::array<OptPixel, Screen::SCREEN_WIDTH>, 4> rows {};
+	std::array<ObjPixel, Screen::SCREEN_WIDTH> objLine;
+	std::array<std::array<PackedPixel, Screen::SCREEN_WIDTH>, 4> rows {};
 
-	Screen::Framebuffer fb {};
+	// Back buffer of the screen, replaced after every presented frame
+	Screen::Framebuffer* fb;
+	// Hashes of the lines last drawn, to tell whether a frame differs from the previous one
+	std::array<std::uint64_t, Screen::SCREEN_HEIGHT> lineHashes {};
+	bool frameChanged = true;
 	State state = Visible;
 	U32 tickCount = 0;
 
@@ -159,6 +256,7 @@ private:
 			  TILE_AREA_HEIGHT = 32, TILE_AREA_WIDTH = 32;
 
 	const U32 TILE_AREA_ADDRESS_INC = 0x800, OBJ_START_ADDRESS = 0x06010000;
+	const U32 OBJ_VRAM_OFFSET = 0x10000, OBJ_VRAM_MASK = 0x7FFF;
 
 	const U32 BGCNT[4] = { BG0CNT, BG1CNT, BG2CNT, BG3CNT };
 
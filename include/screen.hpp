@@ -1,6 +1,7 @@
 #pragma once
 #include "int.hpp"
 #include <array>
+#include <atomic>
 
 class Screen {
 public:
@@ -9,5 +10,50 @@ public:
 					 SCALE = 4;
 	using Framebuffer = std::array<U16, SCREEN_TOTAL>;
 
-	virtual void render(const Framebuffer& fb) = 0;
-};
\ No newline at end of file
+	virtual ~Screen() = default;
+
+	// Triple buffered: the PPU draws into the back buffer while the backend presents
+	// the front one, and the middle buffer holds the newest finished frame
+	Framebuffer& GetBackBuffer() { return buffers[backIndex]; }
+	// Publishes the back buffer as the newest finished frame and takes a free one to draw into.
+	// A frame identical to the previous one is not published and the back buffer is reused.
+	void SwapBuffers(bool frameChanged = true)
+	{
+		if (frameChanged) {
+			backIndex = middle.exchange(backIndex | NEW_FRAME, std::memory_order_acq_rel) & INDEX_MASK;
+		}
+	}
+
+	// Presents the newest finished frame
+	virtual void render() = 0;
+	// Handles host events, samples input and paces emulation. Called once per frame,
+	// including frames that are skipped or not rendered at all.
+	virtual void poll() = 0;
+
+protected:
+	// Makes the newest finished frame the front buffer. Returns false if no new frame was
+	// swapped in since the last call, so the front buffer is already up to date.
+	bool AcquireFrontBuffer()
+	{
+		if (!(middle.load(std::memory_order_relaxed) & NEW_FRAME)) {
+			return false;
+		}
+		frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+	const Framebuffer& FrontBuffer() const { return buffers[frontIndex]; }
+
+private:
+	static const U8 NEW_FRAME = 0x80, INDEX_MASK = 0x03;
+
+	std::array<Framebuffer, 3> buffers {};
+	U8 backIndex = 0, frontIndex = 1;
+	std::atomic<U8> middle { 2 };
+};
+
+// Shows nothing and never waits, so headless runs go as fast as the host allows
+class NullScreen : public Screen {
+public:
+	void render() override { }
+	void poll() override { }
+};
@@ -7,6 +7,9 @@ class SystemClock {
 public:
 	void Tick(U32 ticks) { total += ticks; }
 
+	// Ticks charged since the last SinceLastCheck, without resetting it
+	U32 Unchecked() const { return total - lastCheck; }
+
 	U32 SinceLastCheck()
 	{
 		auto since = total - lastCheck;
@@ -1,31 +1,51 @@
 #include "apu/apu.hpp"
 
-APU::APU(std::function<void()> FIFOACallback, std::function<void()> FIFOBCallback)
+const U32 SAMPLE_CYCLES = (16 * 1024 * 1024) / APU::SAMPLE_RATE;
+// Largest change to the resampling rate, small enough not to be heard as a pitch change
+const double MAX_RATE_ADJUSTMENT = 0.005;
+// Adjustment per fraction of the target the queue is off by. A steady drift, like
+// 60Hz pacing against the GBA's 59.73Hz, settles about 20% above the target.
+const double RATE_CONTROL_GAIN = 0.02;
+// Weight of each block in the moving average of the queue fill, about 100ms of blocks
+const double BUFFERED_SMOOTHING = 1.0 / 64;
+// Mix roughly every 2ms of emulated time
+const U32 MIX_BLOCK_CYCLES = SAMPLE_CYCLES * 64;
+
+APU::APU(std::shared_ptr<SystemClock> clock, std::function<void()> FIFOACallback, std::function<void()> FIFOBCallback, std::shared_ptr<AudioSink> audioSink)
 	: FifoCallbacks({ FIFOACallback, FIFOBCallback })
+	, nextSampleTime(SAMPLE_CYCLES + 1)
+	, clock(clock)
+	, audioSink(audioSink)
+	, resample(audioSink->SampleRate() != SAMPLE_RATE)
+	, resampler(SAMPLE_RATE, audioSink->SampleRate())
+	, averageBuffered(audioSink->TargetBuffered())
 {
-	audioStream.play();
+	sampleEvents.reserve(256);
+	resampledBlock.reserve(SAMPLE_BLOCK_SIZE * 2);
 }
 
-const U32 TICK_THRESHOLD = 512;
 void APU::Tick(U32 t)
 {
-	ticks += t;
-	while (ticks > TICK_THRESHOLD) {
-		ticks -= TICK_THRESHOLD;
-		Sample();
+	now += t;
+	if (now >= nextSampleTime + MIX_BLOCK_CYCLES) {
+		MixUntil(now);
 	}
 }
 
-const U8 CHANNEL_TIMER_SELECT[2] = { 10, 14 };
+void APU::Close()
+{
+	MixUntil(now);
+	if (sampleBlockCount) {
+		PushSampleBlock();
+	}
+	audioSink->Close();
+}
 
 void APU::FIFOUpdate(U8 timerID)
 {
-	for (auto i = 0; i <= 1; i++) {
-		auto soundCntH = Read(AccessSize::Half, SOUNDCNT_H, Sequentiality::FREE);
-		auto timerSelect = CHANNEL_TIMER_SELECT[i];
-		auto timer = BIT_RANGE(soundCntH, timerSelect, timerSelect);
-		if (timer == timerID) {
-			lastSample[i] = fifo[i].Pop();
+	for (U8 i = 0; i <= 1; i++) {
+		if (soundCntH.timerSelect[i] == timerID) {
+			sampleEvents.push_back({ now, i, fifo[i].Pop() });
 			if (fifo[i].Size() <= FIFO_SIZE / 2) {
 				FifoCallbacks[i]();
 			}
@@ -33,33 +53,51 @@ void APU::FIFOUpdate(U8 timerID)
 	}
 }
 
-struct SoundCntH {
-	SoundCntH(U16 v)
-	{
-		value = v;
-		aVolume = BIT_RANGE(value, 2, 2) ? 4 : 2;
-		bVolume = BIT_RANGE(value, 3, 3) ? 4 : 2;
-		enableA[0] = BIT_RANGE(value, 8, 8);
-		enableA[1] = BIT_RANGE(value, 9, 9);
-		enableB[0] = BIT_RANGE(value, 12, 12);
-		enableB[1] = BIT_RANGE(value, 13, 13);
-	}
-	U16 value;
-	U8 aVolume;
-	U8 bVolume;
-	bool enableA[2];
-	bool enableB[2];
-};
-
-void APU::Sample()
+void APU::FIFOWrite(U8 id, const S8* samples, size_t count)
+{
+	fifo[id].Push(samples, count);
+}
+
+APU::SoundCntH::SoundCntH(U16 value)
 {
-	auto soundBias = Read(AccessSize::Half, SOUNDBIAS, Sequentiality::FREE);
-	auto biasLevel = BIT_RANGE(soundBias, 1, 9);
+	// 25%, 50% and 100%, with 3 being prohibited
+	psgVolumeShift = 2 >> std::min<U16>(BIT_RANGE(value, 0, 1), 2);
+	aVolume = BIT_RANGE(value, 2, 2) ? 4 : 2;
+	bVolume = BIT_RANGE(value, 3, 3) ? 4 : 2;
+	enableA[0] = BIT_RANGE(value, 8, 8);
+	enableA[1] = BIT_RANGE(value, 9, 9);
+	timerSelect[0] = BIT_RANGE(value, 10, 10);
+	enableB[0] = BIT_RANGE(value, 12, 12);
+	enableB[1] = BIT_RANGE(value, 13, 13);
+	timerSelect[1] = BIT_RANGE(value, 14, 14);
+}
+
+void APU::DecodeMixerRegisters()
+{
+	soundCntH = SoundCntH(Read(AccessSize::Half, SOUNDCNT_H, Sequentiality::FREE));
+	biasLevel = BIT_RANGE(Read(AccessSize::Half, SOUNDBIAS, Sequentiality::FREE), 1, 9);
+}
+
+void APU::MixUntil(std::uint64_t time)
+{
+	size_t event = 0;
+	for (; nextSampleTime <= time; nextSampleTime += SAMPLE_CYCLES) {
+		// A sample hears every FIFO change from before it
+		for (; event < sampleEvents.size() && sampleEvents[event].time < nextSampleTime; event++) {
+			lastSample[sampleEvents[event].fifo] = sampleEvents[event].sample;
+		}
+		MixSample();
+	}
+	sampleEvents.erase(sampleEvents.begin(), sampleEvents.begin() + event);
+}
 
-	auto soundCntH = SoundCntH(Read(AccessSize::Half, SOUNDCNT_H, Sequentiality::FREE));
+void APU::MixSample()
+{
+	S16 psgSample[2];
+	psg.Sample(SAMPLE_CYCLES, psgSample[1], psgSample[0]);
 
 	for (U8 i = 0; i < 2; i++) {
-		S16 sample = 0;
+		S16 sample = psgSample[i] >> soundCntH.psgVolumeShift;
 		if (soundCntH.enableA[i])
 			sample += lastSample[0] * soundCntH.aVolume;
 		if (soundCntH.enableB[i])
@@ -72,7 +110,35 @@ void APU::Sample()
 		sample -= 0x200;
 		sample *= 20;
 
-		//out.write(reinterpret_cast<char const *>(&sample), sizeof sample);
-		audioStream.PushOne(sample);
+		sampleBlock[sampleBlockCount++] = sample;
+	}
+
+	if (sampleBlockCount == SAMPLE_BLOCK_SIZE) {
+		PushSampleBlock();
+		if (resample && audioSink->TargetBuffered()) {
+			UpdateRateControl();
+		}
 	}
-}
\ No newline at end of file
+}
+
+void APU::PushSampleBlock()
+{
+	if (resample) {
+		resampler.Process(sampleBlock.data(), sampleBlockCount / Resampler::CHANNELS, resampledBlock);
+		audioSink->Push(resampledBlock.data(), resampledBlock.size());
+		resampledBlock.clear();
+	} else {
+		audioSink->Push(sampleBlock.data(), sampleBlockCount);
+	}
+	sampleBlockCount = 0;
+}
+
+void APU::UpdateRateControl()
+{
+	// The queue drops a whole chunk at a time, so steer by its average instead
+	averageBuffered += (audioSink->Buffered() - averageBuffered) * BUFFERED_SMOOTHING;
+
+	double target = audioSink->TargetBuffered();
+	double error = (target - averageBuffered) / target;
+	resampler.SetRateAdjustment(std::clamp(error * RATE_CONTROL_GAIN, -MAX_RATE_ADJUSTMENT, MAX_RATE_ADJUSTMENT));
+}
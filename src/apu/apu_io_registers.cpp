@@ -2,11 +2,23 @@
 #include "memory/regions.hpp"
 #include "utils.hpp"
 
+static U32 AccessBytes(const AccessSize& size)
+{
+	return size == Word ? 4u : (size == Half ? 2u : 1u);
+}
+
 U32 APU::Read(const AccessSize& size, U32 address, const Sequentiality&)
 {
 	U32 actualIndex = address - APU_IO_START;
 	auto value = ReadToSize(registers, actualIndex, size);
 
+	// Channels turn themselves off as their length runs out
+	if (address <= SOUNDCNT_X && address + AccessBytes(size) > SOUNDCNT_X) {
+		MixUntil(AccessTime());
+		auto shift = (SOUNDCNT_X - address) * 8;
+		value = (value & ~(0xFu << shift)) | (psg.Status() << shift);
+	}
+
 	return value;
 }
 
@@ -22,6 +34,31 @@ void APU::Write(const AccessSize& size, U32 address, U32 value, const Sequential
 		fifo[1].Push((S8)BIT_RANGE(value, 0, 7));
 		fifo[1].Push((S8)BIT_RANGE(value, 8, 15));
 	}
+	// Samples up to now are mixed with the old settings
+	auto bytes = AccessBytes(size);
+	bool mixerRegister = address < FIFO_A;
+	if (mixerRegister) {
+		MixUntil(AccessTime());
+	}
+
 	U32 actualIndex = address - APU_IO_START;
 	WriteToSize(registers, actualIndex, value, size);
+
+	if (!mixerRegister) {
+		return;
+	}
+	DecodeMixerRegisters();
+
+	for (U32 byte = address; byte < address + bytes; byte++) {
+		if (byte >= WAVE_RAM) {
+			psg.WriteWaveRAM(byte - WAVE_RAM, registers[byte - APU_IO_START]);
+			continue;
+		}
+		// Each halfword is decoded once, at its upper byte if the write reaches it
+		bool upperByte = byte % 2;
+		U32 half = byte & ~1u;
+		if ((upperByte || byte + 1 == address + bytes) && half != SOUNDCNT_H) {
+			psg.WriteRegister(half, ReadToSize(registers, half - APU_IO_START, AccessSize::Half), upperByte);
+		}
+	}
 }
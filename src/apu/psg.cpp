@@ -0,0 +1,303 @@
+#include "apu/psg.hpp"
+#include "memory/regions.hpp"
+
+#include "utils.hpp"
+
+// Sequencer steps are 512Hz apart
+const U32 FRAME_SEQUENCER_CYCLES = 32768;
+
+// Output level of each of the 8 steps of a square wave period, per duty setting
+const U8 DUTY_PATTERNS[4] = { 0b00000001, 0b10000001, 0b10000111, 0b01111110 };
+
+// https://problemkaputt.de/gbatek.htm#gbasoundchannel3waveoutput
+const U8 WAVE_SAMPLES = 32;
+
+// https://problemkaputt.de/gbatek.htm#gbasoundchannel4noise
+const U16 NOISE_TAPS_7BIT = 0x60, NOISE_TAPS_15BIT = 0x6000;
+
+void PSG::Envelope::Write(U16 value)
+{
+	stepTime = BIT_RANGE(value, 8, 10);
+	increase = BIT_RANGE(value, 11, 11);
+	initialVolume = BIT_RANGE(value, 12, 15);
+}
+
+void PSG::Envelope::Restart()
+{
+	volume = initialVolume;
+	timer = stepTime;
+}
+
+void PSG::Envelope::Clock()
+{
+	if (stepTime == 0 || --timer != 0) {
+		return;
+	}
+	timer = stepTime;
+	if (increase && volume < 15) {
+		volume++;
+	} else if (!increase && volume > 0) {
+		volume--;
+	}
+}
+
+void PSG::Length::Restart()
+{
+	if (counter == 0) {
+		counter = maxLength;
+	}
+}
+
+bool PSG::Length::Clock()
+{
+	if (!enabled || counter == 0) {
+		return true;
+	}
+	return --counter != 0;
+}
+
+U32 PSG::AdvanceTimer(U32& timer, U32 period, U32 cycles)
+{
+	if (timer > cycles) {
+		timer -= cycles;
+		return 0;
+	}
+	auto over = cycles - timer;
+	timer = period - (over % period);
+	return 1 + (over / period);
+}
+
+void PSG::WriteRegister(U32 address, U16 value, bool upperByteWritten)
+{
+	bool restart = upperByteWritten && BIT_RANGE(value, 15, 15);
+
+	switch (address) {
+	case SOUND1CNT_L:
+		squares[0].sweepShift = BIT_RANGE(value, 0, 2);
+		squares[0].sweepDecrease = BIT_RANGE(value, 3, 3);
+		squares[0].sweepTime = BIT_RANGE(value, 4, 6);
+		break;
+	case SOUND1CNT_H:
+	case SOUND2CNT_L: {
+		auto& square = squares[address == SOUND1CNT_H ? 0 : 1];
+		square.length.Load(BIT_RANGE(value, 0, 5));
+		square.duty = BIT_RANGE(value, 6, 7);
+		square.envelope.Write(value);
+		// Zero volume without an increase turns the channel's DAC off
+		if (square.envelope.initialVolume == 0 && !square.envelope.increase) {
+			square.on = false;
+		}
+		break;
+	}
+	case SOUND1CNT_X:
+	case SOUND2CNT_H: {
+		U8 id = address == SOUND1CNT_X ? 0 : 1;
+		squares[id].frequency = BIT_RANGE(value, 0, 10);
+		squares[id].length.enabled = BIT_RANGE(value, 14, 14);
+		if (restart) {
+			RestartSquare(id);
+		}
+		break;
+	}
+	case SOUND3CNT_L:
+		wave.doubleBank = BIT_RANGE(value, 5, 5);
+		wave.bank = BIT_RANGE(value, 6, 6);
+		wave.playing = BIT_RANGE(value, 7, 7);
+		if (!wave.playing) {
+			wave.on = false;
+		}
+		break;
+	case SOUND3CNT_H:
+		wave.length.Load(BIT_RANGE(value, 0, 7));
+		wave.volume = BIT_RANGE(value, 13, 14);
+		wave.forceVolume = BIT_RANGE(value, 15, 15);
+		break;
+	case SOUND3CNT_X:
+		wave.frequency = BIT_RANGE(value, 0, 10);
+		wave.length.enabled = BIT_RANGE(value, 14, 14);
+		if (restart && wave.playing) {
+			wave.on = true;
+			wave.position = 0;
+			wave.timer = 8 * (2048 - wave.frequency);
+			wave.length.Restart();
+		}
+		break;
+	case SOUND4CNT_L:
+		noise.length.Load(BIT_RANGE(value, 0, 5));
+		noise.envelope.Write(value);
+		if (noise.envelope.initialVolume == 0 && !noise.envelope.increase) {
+			noise.on = false;
+		}
+		break;
+	case SOUND4CNT_H: {
+		// 524288Hz / r / 2^(s+1), with r = 0 counting as 0.5
+		U32 ratio = BIT_RANGE(value, 0, 2);
+		U32 shift = BIT_RANGE(value, 4, 7);
+		noise.period = (ratio == 0 ? 16 : 32 * ratio) << (shift + 1);
+		noise.narrow = BIT_RANGE(value, 3, 3);
+		noise.length.enabled = BIT_RANGE(value, 14, 14);
+		if (restart) {
+			noise.on = noise.envelope.initialVolume != 0 || noise.envelope.increase;
+			noise.lfsr = noise.narrow ? 0x40 : 0x4000;
+			noise.timer = noise.period;
+			noise.envelope.Restart();
+			noise.length.Restart();
+		}
+		break;
+	}
+	case SOUNDCNT_L:
+		volumeRight = BIT_RANGE(value, 0, 2);
+		volumeLeft = BIT_RANGE(value, 4, 6);
+		for (U8 i = 0; i < CHANNELS; i++) {
+			enableRight[i] = (value >> (i + 8)) & 1;
+			enableLeft[i] = (value >> (i + 12)) & 1;
+		}
+		break;
+	case SOUNDCNT_X:
+		masterEnable = BIT_RANGE(value, 7, 7);
+		if (!masterEnable) {
+			squares[0].on = squares[1].on = wave.on = noise.on = false;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+void PSG::WriteWaveRAM(U32 offset, U8 value)
+{
+	wave.ram[wave.bank ^ 1][offset] = value;
+}
+
+void PSG::RestartSquare(U8 id)
+{
+	auto& square = squares[id];
+	square.on = square.envelope.initialVolume != 0 || square.envelope.increase;
+	square.timer = 16 * (2048 - square.frequency);
+	square.envelope.Restart();
+	square.length.Restart();
+	square.sweepTimer = square.sweepTime;
+}
+
+void PSG::ClockSweep()
+{
+	auto& square = squares[0];
+	if (square.sweepTime == 0 || --square.sweepTimer != 0) {
+		return;
+	}
+	square.sweepTimer = square.sweepTime;
+
+	U16 delta = square.frequency >> square.sweepShift;
+	U32 frequency = square.sweepDecrease ? square.frequency - delta : square.frequency + delta;
+	if (frequency > 2047) {
+		square.on = false;
+	} else if (square.sweepShift != 0) {
+		square.frequency = frequency;
+	}
+}
+
+void PSG::ClockFrameSequencer()
+{
+	// Length counters at 256Hz, sweep at 128Hz and envelopes at 64Hz
+	if (frameSequencerStep % 2 == 0) {
+		squares[0].on &= squares[0].length.Clock();
+		squares[1].on &= squares[1].length.Clock();
+		wave.on &= wave.length.Clock();
+		noise.on &= noise.length.Clock();
+	}
+	if (frameSequencerStep == 2 || frameSequencerStep == 6) {
+		ClockSweep();
+	}
+	if (frameSequencerStep == 7) {
+		squares[0].envelope.Clock();
+		squares[1].envelope.Clock();
+		noise.envelope.Clock();
+	}
+	frameSequencerStep = (frameSequencerStep + 1) % 8;
+}
+
+S16 PSG::SquareOutput(U8 id, U32 cycles)
+{
+	auto& square = squares[id];
+	auto steps = AdvanceTimer(square.timer, 16 * (2048 - square.frequency), cycles);
+	square.dutyStep = (square.dutyStep + steps) % 8;
+	bool high = BIT_RANGE(DUTY_PATTERNS[square.duty], square.dutyStep, square.dutyStep);
+	return high ? square.envelope.volume : -square.envelope.volume;
+}
+
+S16 PSG::WaveOutput(U32 cycles)
+{
+	auto steps = AdvanceTimer(wave.timer, 8 * (2048 - wave.frequency), cycles);
+	U8 samples = wave.doubleBank ? WAVE_SAMPLES * 2 : WAVE_SAMPLES;
+	wave.position = (wave.position + steps) % samples;
+
+	// Two banks play the selected one first; each byte holds two samples, upper nibble first
+	auto bank = wave.bank ^ (wave.position / WAVE_SAMPLES);
+	auto byte = wave.ram[bank][(wave.position % WAVE_SAMPLES) / 2];
+	S16 sample = ((wave.position % 2) ? BIT_RANGE(byte, 0, 3) : BIT_RANGE(byte, 4, 7)) * 2 - 15;
+
+	if (wave.forceVolume) {
+		return sample * 3 / 4;
+	}
+	switch (wave.volume) {
+	case 0:
+		return 0;
+	case 1:
+		return sample;
+	case 2:
+		return sample / 2;
+	default:
+		return sample / 4;
+	}
+}
+
+S16 PSG::NoiseOutput(U32 cycles)
+{
+	auto steps = AdvanceTimer(noise.timer, noise.period, cycles);
+	for (U32 i = 0; i < steps; i++) {
+		noise.high = noise.lfsr & 1;
+		noise.lfsr >>= 1;
+		if (noise.high) {
+			noise.lfsr ^= noise.narrow ? NOISE_TAPS_7BIT : NOISE_TAPS_15BIT;
+		}
+	}
+	return noise.high ? noise.envelope.volume : -noise.envelope.volume;
+}
+
+void PSG::Sample(U32 cycles, S16& left, S16& right)
+{
+	left = right = 0;
+	if (!masterEnable) {
+		return;
+	}
+
+	frameSequencerCycles += cycles;
+	while (frameSequencerCycles >= FRAME_SEQUENCER_CYCLES) {
+		frameSequencerCycles -= FRAME_SEQUENCER_CYCLES;
+		ClockFrameSequencer();
+	}
+
+	if (!Status()) {
+		return;
+	}
+
+	std::array<S16, CHANNELS> outputs {
+		squares[0].on ? SquareOutput(0, cycles) : S16 { 0 },
+		squares[1].on ? SquareOutput(1, cycles) : S16 { 0 },
+		wave.on ? WaveOutput(cycles) : S16 { 0 },
+		noise.on ? NoiseOutput(cycles) : S16 { 0 },
+	};
+	for (U8 i = 0; i < CHANNELS; i++) {
+		if (enableRight[i])
+			right += outputs[i];
+		if (enableLeft[i])
+			left += outputs[i];
+	}
+	right *= volumeRight + 1;
+	left *= volumeLeft + 1;
+}
+
+U8 PSG::Status() const
+{
+	return squares[0].on | (squares[1].on << 1) | (wave.on << 2) | (noise.on << 3);
+}
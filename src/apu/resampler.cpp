@@ -0,0 +1,129 @@
+#include "apu/resampler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Stopband attenuation of roughly 80dB
+const double KAISER_BETA = 8.0;
+// Leave some room for the transition band below Nyquist
+const double PASSBAND = 0.9;
+
+const U32 VECTOR_TAPS = 4;
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window
+static double BesselI0(double x)
+{
+	double sum = 1, term = 1;
+	for (U32 k = 1; term > sum * 1e-12; k++) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+Resampler::Resampler(U32 inputRate, U32 outputRate)
+	: coefficients((PHASES + 1) * TAPS)
+	, nominalStep((double)inputRate / outputRate)
+	, step(nominalStep)
+{
+	// Cutoff relative to the input rate, lowered when downsampling to avoid aliasing
+	double cutoff = 0.5 * PASSBAND * std::min(1.0, 1 / step);
+	double halfWidth = TAPS / 2.0;
+
+	for (U32 phase = 0; phase <= PHASES; phase++) {
+		auto* row = &coefficients[phase * TAPS];
+		double sum = 0;
+		for (U32 tap = 0; tap < TAPS; tap++) {
+			double t = (halfWidth - 1) + ((double)phase / PHASES) - tap;
+			double x = 2 * cutoff * t;
+			double sinc = x == 0 ? 1 : std::sin(M_PI * x) / (M_PI * x);
+			double ratio = t / halfWidth;
+			double window = std::abs(ratio) >= 1 ? 0 : BesselI0(KAISER_BETA * std::sqrt(1 - (ratio * ratio))) / BesselI0(KAISER_BETA);
+			row[tap] = sinc * window;
+			sum += row[tap];
+		}
+		// Unity gain at DC for every phase
+		for (U32 tap = 0; tap < TAPS; tap++) {
+			row[tap] /= sum;
+		}
+	}
+
+	// Pad with silence so the first input frame lands in the middle of the first output's taps
+	for (auto& channel : history) {
+		channel.assign((TAPS / 2) - 1, 0.0f);
+	}
+}
+
+void Resampler::Process(const S16* input, size_t frames, std::vector<S16>& output)
+{
+	for (U32 channel = 0; channel < CHANNELS; channel++) {
+		auto& samples = history[channel];
+		for (size_t frame = 0; frame < frames; frame++) {
+			samples.push_back(input[(frame * CHANNELS) + channel]);
+		}
+	}
+
+	size_t available = history[0].size();
+	while ((size_t)position + TAPS <= available) {
+		auto first = (size_t)position;
+		float fraction = (position - first) * PHASES;
+		auto phase = (U32)fraction;
+		fraction -= phase;
+
+		const auto* row = &coefficients[phase * TAPS];
+		for (U32 channel = 0; channel < CHANNELS; channel++) {
+			float sample = Convolve(&history[channel][first], row, row + TAPS, fraction);
+			output.push_back((S16)std::clamp(std::lround(sample), -32768L, 32767L));
+		}
+		position += step;
+	}
+
+	// Drop the input frames no later output frame reaches back to
+	auto consumed = std::min((size_t)position, available);
+	for (auto& channel : history) {
+		channel.erase(channel.begin(), channel.begin() + consumed);
+	}
+	position -= consumed;
+}
+
+float Resampler::Convolve(const float* samples, const float* phase, const float* nextPhase, float fraction) const
+{
+	U32 tap = 0;
+	float sum = 0;
+
+#if defined(__SSE2__)
+	__m128 weight = _mm_set1_ps(fraction);
+	__m128 acc = _mm_setzero_ps();
+	for (; tap + VECTOR_TAPS <= TAPS; tap += VECTOR_TAPS) {
+		__m128 c0 = _mm_loadu_ps(phase + tap);
+		__m128 c1 = _mm_loadu_ps(nextPhase + tap);
+		__m128 c = _mm_add_ps(c0, _mm_mul_ps(_mm_sub_ps(c1, c0), weight));
+		acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(samples + tap), c));
+	}
+	// Horizontal sum of the four lanes
+	acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+	acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 0x55));
+	sum = _mm_cvtss_f32(acc);
+#elif defined(__ARM_NEON)
+	float32x4_t acc = vdupq_n_f32(0);
+	for (; tap + VECTOR_TAPS <= TAPS; tap += VECTOR_TAPS) {
+		float32x4_t c0 = vld1q_f32(phase + tap);
+		float32x4_t c1 = vld1q_f32(nextPhase + tap);
+		float32x4_t c = vmlaq_n_f32(c0, vsubq_f32(c1, c0), fraction);
+		acc = vmlaq_f32(acc, vld1q_f32(samples + tap), c);
+	}
+	float32x2_t pair = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+	sum = vget_lane_f32(vpadd_f32(pair, pair), 0);
+#endif
+
+	for (; tap < TAPS; tap++) {
+		sum += samples[tap] * (phase[tap] + ((nextPhase[tap] - phase[tap]) * fraction));
+	}
+	return sum;
+}
@@ -1,6 +1,16 @@
 #include "dma/channel.hpp"
+#include "ppu/lcd_io_registers.hpp"
+#include <algorithm>
 
 using namespace DMA;
+
+// Units moved per bulk copy. Blocks are also cut short at the PPU's next state
+// change, so HBlank and VBlank start DMA on time.
+const U32 MAX_BLOCK_UNITS = 128;
+
+// https://problemkaputt.de/gbatek.htm#gbadmatransfers
+const U32 STARTUP_CYCLES = 2, GAMEPAK_STARTUP_CYCLES = 4;
+const U32 GAMEPAK_START = 0x08000000;
 Channel::Channel(std::int_fast8_t id, std::shared_ptr<Memory> memory_)
 	: ID(id)
 	, SAD(DMA0SAD + ID * 0xC)
@@ -100,20 +110,77 @@ void Channel::UpdateDetails(U16 value)
 	CalculateTransferSteps();
 }
 
-void Channel::DoSoundTransfer()
+bool Channel::TransferLCDRegisters(const LCDWriteCallback& lcdWrite, const AccessSize& size, U32 units)
+{
+	S32 unit = size == Word ? 4 : 2;
+	U32 last = dest + (destStep * (S32)(units - 1));
+	const auto start = LCDIORegisters::LCD_IO_START, end = LCDIORegisters::LCD_IO_END;
+	if (!IN_RANGE(dest, start, end) || !IN_RANGE(last, start, end - unit + 1)) {
+		return false;
+	}
+
+	std::array<U32, MAX_BLOCK_UNITS> values;
+	auto write = [&](const U32* read) { lcdWrite(size, dest, destStep, read, units); };
+	if (!memory->BlockTransfer(size, dest, destStep, source, srcStep, units, values.data(), write)) {
+		return false;
+	}
+
+	dest += destStep * (S32)units;
+	source += srcStep * (S32)units;
+	wordCount -= units;
+	return true;
+}
+
+U32 Channel::StartupCycles() const
+{
+	bool gamePak = source >= GAMEPAK_START && dest >= GAMEPAK_START;
+	return gamePak ? GAMEPAK_STARTUP_CYCLES : STARTUP_CYCLES;
+}
+
+// https://problemkaputt.de/gbatek.htm#gbasoundchannelaandbdmasound
+void Channel::DoSoundTransfer(const FIFOWriteCallback& fifoWrite)
 {
+	if (!fifoWrite) {
+		for (int i = 0; i < 4; i++) {
+			U32 readVal = memory->Read(Word, source, SEQ);
+			memory->Write(Word, dest, readVal, SEQ);
+			source += srcStep;
+		}
+		active = false;
+		return;
+	}
 
-	for (int i = 0; i < 4; i++) {
+	// Always four words, pushed to the FIFO in one go; the writes still cost their bus cycles
+	std::array<S8, 16> samples;
+	for (U32 i = 0; i < 4; i++) {
 		U32 readVal = memory->Read(Word, source, SEQ);
-		memory->Write(Word, dest, readVal, SEQ);
+		for (U32 byte = 0; byte < 4; byte++) {
+			samples[(i * 4) + byte] = (S8)(readVal >> (byte * 8));
+		}
+		memory->TickAccess(Word, dest, SEQ);
 		source += srcStep;
 	}
+	fifoWrite(dest == FIFO_A ? 0 : 1, samples.data(), samples.size());
 	active = false;
 }
 
-void Channel::DoTransferStep()
+void Channel::DoTransferStep(const LCDWriteCallback& lcdWrite, U32 maxCycles)
 {
 	if (wordCount > 0) {
+		// Plain memory is copied in blocks, IO and cart backup a unit at a time
+		auto size = transferType ? Word : Half;
+		auto unitTicks = std::max(memory->TransferTicks(size, dest, source), 2u);
+		auto units = std::min({ wordCount, MAX_BLOCK_UNITS, std::max(maxCycles / unitTicks, 1u) });
+		if (lcdWrite && TransferLCDRegisters(lcdWrite, size, units)) {
+			return;
+		}
+		if (memory->BlockTransfer(size, dest, destStep, source, srcStep, units)) {
+			dest += destStep * (S32)units;
+			source += srcStep * (S32)units;
+			wordCount -= units;
+			return;
+		}
+
 		// TODO: if first recent transfer NSEQ
 		if (transferType) {
 			memory->Write(Word, dest, memory->Read(Word, source, SEQ), SEQ);
@@ -129,6 +196,10 @@ void Channel::DoTransferStep()
 			if (destAddrCtl == 3) {
 				ReloadDAD();
 			}
+			// Blanking triggered transfers wait for the next edge to run again
+			if (startTiming != 0) {
+				active = false;
+			}
 		} else {
 			// Transfer Finished
 			BIT_CLEAR(dmaCnt, 15);
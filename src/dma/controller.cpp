@@ -4,33 +4,39 @@ using namespace DMA;
 
 void Controller::Execute()
 {
-	for (const auto& c : channels) {
-		if (c->active) {
-			if (c->startTiming == (U16)Event::SPECIAL)
-				c->DoSoundTransfer();
-			else
-				c->DoTransferStep();
+	U8 id = __builtin_ctz(activeChannels);
+	const auto& channel = channels[id];
 
-			return;
-		}
+	if (startingChannels & (1 << id)) {
+		startingChannels &= ~(1 << id);
+		clock->Tick(channel->StartupCycles());
 	}
-	controllerActive = false;
-	return;
-}
 
-bool Controller::IsActive()
-{
-	if (!controllerActive) {
-		return false;
+	U32 maxCycles = cycleBudget ? cycleBudget() : UINT32_MAX;
+	if (channel->startTiming == (U16)Event::SPECIAL)
+		channel->DoSoundTransfer(fifoWrite);
+	else if (channel->startTiming == (U16)Event::HBLANK)
+		channel->DoTransferStep(lcdWrite, maxCycles);
+	else
+		channel->DoTransferStep({}, maxCycles);
+
+	if (!channel->active) {
+		SetActive(id, false);
 	}
+}
 
-	for (const auto& c : channels) {
-		if (c->active) {
-			return true;
+void Controller::SetActive(U8 id, bool active)
+{
+	channels[id]->active = active;
+	if (active) {
+		if (!(activeChannels & (1 << id))) {
+			startingChannels |= 1 << id;
 		}
+		activeChannels |= 1 << id;
+	} else {
+		activeChannels &= ~(1 << id);
+		startingChannels &= ~(1 << id);
 	}
-	controllerActive = false;
-	return false;
 }
 
 void Controller::CntHUpdateCallback(U8 id, U16 value)
@@ -38,8 +44,9 @@ void Controller::CntHUpdateCallback(U8 id, U16 value)
 	channels[id]->UpdateDetails(value);
 
 	if (channels[id]->enable && channels[id]->startTiming == (U16)IMMEDIATE) {
-		channels[id]->active = true;
-		controllerActive = true;
+		SetActive(id, true);
+	} else if (!channels[id]->active) {
+		SetActive(id, false);
 	}
 }
 
@@ -54,23 +61,13 @@ void Controller::EventCallback(Event event, bool start)
 				dest = FIFO_B;
 
 			if (channel->enable && channel->startTiming == (U16)Event::SPECIAL && channel->dest == dest) {
-				if (start) {
-					channel->active = true;
-					controllerActive = true;
-				} else {
-					channel->active = false;
-				}
+				SetActive(channel_index, start);
 			}
 		}
 	} else {
-		for (const auto& c : channels) {
-			if (c->enable && c->startTiming == (U16)event) {
-				if (start) {
-					c->active = true;
-					controllerActive = true;
-				} else {
-					c->active = false;
-				}
+		for (U8 id = 0; id < 4; id++) {
+			if (channels[id]->enable && channels[id]->startTiming == (U16)event) {
+				SetActive(id, start);
 			}
 		}
 	}
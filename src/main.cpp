@@ -1,24 +1,77 @@
 
 #include "debugger.hpp"
 #include "gba.hpp"
+#include "platform/sfml/audio.hpp"
 #include "platform/sfml/joypad.hpp"
 #include "platform/sfml/window.hpp"
+#include "platform/wav_audio_sink.hpp"
 #include <iostream>
+#include <memory>
 #include <string>
 #include <utility>
 
 int main(int argc, char* argv[])
 {
 
-	if (argc != 3) {
+	if (argc < 3) {
 		std::cerr << "Wrong number of args" << std::endl;
 		return -1;
 	}
 
-	WindowSFML window;
 	std::string biosPath = argv[1];
 	std::string romPath = argv[2];
-	GBAConfig cfg { biosPath, romPath, window, window.joypad };
+	bool threadedRender = false;
+	auto renderPolicy = PPU::RenderPolicy::Always;
+	U32 frameInterval = 1;
+	U32 frameLimit = 0;
+	// Milliseconds of audio the SFML stream keeps queued
+	U32 audioLatency = 64;
+	std::string audioDumpPath;
+	bool audio = true;
+
+	for (int i = 3; i < argc; i++) {
+		std::string option = argv[i];
+		if (option == "--threaded-ppu") {
+			threadedRender = true;
+		} else if (option == "--frame-skip" && i + 1 < argc) {
+			renderPolicy = PPU::RenderPolicy::EveryNthFrame;
+			frameInterval = std::stoul(argv[++i]) + 1;
+		} else if (option == "--no-render") {
+			renderPolicy = PPU::RenderPolicy::Never;
+		} else if (option == "--frames" && i + 1 < argc) {
+			frameLimit = std::stoul(argv[++i]);
+		} else if (option == "--audio-latency" && i + 1 < argc) {
+			audioLatency = std::stoul(argv[++i]);
+		} else if (option == "--audio-dump" && i + 1 < argc) {
+			audioDumpPath = argv[++i];
+		} else if (option == "--no-audio") {
+			audio = false;
+		} else {
+			std::cerr << "Unknown option " << option << std::endl;
+			return -1;
+		}
+	}
+
+	// Without rendering there is no window, input or frame pacing
+	NullScreen nullScreen;
+	NullJoypad nullJoypad;
+	std::unique_ptr<WindowSFML> window;
+	if (renderPolicy != PPU::RenderPolicy::Never) {
+		window = std::make_unique<WindowSFML>();
+	}
+	Screen& screen = window ? static_cast<Screen&>(*window) : nullScreen;
+	Joypad& joypad = window ? static_cast<Joypad&>(window->joypad) : nullJoypad;
+
+	GBAConfig cfg { biosPath, romPath, screen, joypad };
+	cfg.threadedRender = threadedRender;
+	cfg.renderPolicy = renderPolicy;
+	cfg.frameInterval = frameInterval;
+	cfg.frameLimit = frameLimit;
+	if (!audioDumpPath.empty()) {
+		cfg.audioSink = std::make_shared<WavAudioSink>(audioDumpPath, APU::SAMPLE_RATE);
+	} else if (audio) {
+		cfg.audioSink = std::make_shared<AudioStream>(audioLatency);
+	}
 	GBA gba(std::move(cfg));
 	gba.run();
 }
\ No newline at end of file
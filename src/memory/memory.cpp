@@ -1,4 +1,5 @@
 #include "memory/memory.hpp"
+#include <algorithm>
 #include <cstring>
 #include <fstream>
 #include <iostream>
@@ -163,12 +164,20 @@ void Memory::Write(const AccessSize& size, U32 address, U32 value, const Sequent
 		break;
 	case 0x05:
 		WriteToSize(mem.disp.pram, address & PRAM_MASK, value, size);
+		if (trackDisplayWrites)
+			MarkDisplayWrite(0, address & PRAM_MASK, size);
 		break;
 	case 0x06:
 		WriteToSize(mem.disp.vram, address & VRAM_MASK, value, size);
+		if (trackDisplayWrites)
+			MarkDisplayWrite(DisplayMemory::PRAM_BLOCKS, address & VRAM_MASK, size);
 		break;
 	case 0x07:
 		WriteToSize(mem.disp.oam, address & OAM_MASK, value, size);
+		if (trackDisplayWrites)
+			MarkDisplayWrite(DisplayMemory::OAM_FIRST_BLOCK, address & OAM_MASK, size);
+		if (OAMWriteCallback)
+			OAMWriteCallback(address & OAM_MASK, size);
 		break;
 	case 0x0E:
 		mem.ext.backup->Write(address, value);
@@ -177,92 +186,256 @@ void Memory::Write(const AccessSize& size, U32 address, U32 value, const Sequent
 	}
 }
 
-void Memory::TickBySize(const AccessSize& size, const U32& ticks8, const U32& ticks16, const U32& ticks32)
+U8* Memory::PlainRegion(U32 address, U32& mask, U32& size)
 {
-	switch (size) {
-	case Byte:
-		clock->Tick(ticks8);
+	switch (address >> 24) {
+	case 0x02:
+		mask = WRAMB_MASK;
+		size = WRAMB_SIZE;
+		return mem.gen.wramb.data();
+	case 0x03:
+		mask = WRAMC_MASK;
+		size = WRAMC_SIZE;
+		return mem.gen.wramc.data();
+	case 0x05:
+		mask = PRAM_MASK;
+		size = PRAM_SIZE;
+		return mem.disp.pram.data();
+	case 0x06:
+		mask = VRAM_MASK;
+		size = VRAM_SIZE;
+		return mem.disp.vram.data();
+	case 0x07:
+		mask = OAM_MASK;
+		size = OAM_SIZE;
+		return mem.disp.oam.data();
+	case 0x08:
+	case 0x09:
+	case 0x0A:
+	case 0x0B:
+	case 0x0C:
+	case 0x0D:
+		mask = ROM_MASK;
+		size = ROM_SIZE;
+		return mem.ext.rom.data();
+	default:
+		return nullptr;
+	}
+}
+
+// Whether count units stepping from start stay inside a region, without wrapping through its mask
+static bool RangeInside(S32 start, S32 step, U32 count, S32 unit, U32 regionSize)
+{
+	S32 end = start + (step * (S32)(count - 1));
+	return std::min(start, end) >= 0 && std::max(start, end) + unit <= (S32)regionSize;
+}
+
+bool Memory::BlockTransfer(const AccessSize& size, U32 dest, S32 destStep, U32 source, S32 srcStep, U32 count)
+{
+	U32 destMask, destSize, srcMask, srcSize;
+	U8* destRegion = PlainRegion(dest, destMask, destSize);
+	U8* srcRegion = PlainRegion(source, srcMask, srcSize);
+	bool romDest = (dest >> 24) >= 0x08;
+	if (!destRegion || romDest || !srcRegion || count == 0) {
+		return false;
+	}
+
+	S32 unit = size == Word ? 4 : (size == Half ? 2 : 1);
+	S32 destStart = dest & destMask, srcStart = source & srcMask;
+	if (!RangeInside(destStart, destStep, count, unit, destSize) || !RangeInside(srcStart, srcStep, count, unit, srcSize)) {
+		return false;
+	}
+
+	U8* to = destRegion + destStart;
+	const U8* from = srcRegion + srcStart;
+	// Copying forwards onto a later part of the source repeats data, unlike memmove
+	bool overlapping = destRegion == srcRegion && to > from && to < from + (count * unit);
+	if (destStep == unit && srcStep == unit && !overlapping) {
+		std::memmove(to, from, count * unit);
+	} else if (srcStep == 0) {
+		// Fixed source, the same unit is written everywhere
+		U32 value = 0;
+		std::memcpy(&value, from, unit);
+		for (U32 i = 0; i < count; i++) {
+			std::memcpy(to + (destStep * (S32)i), &value, unit);
+		}
+	} else {
+		for (U32 i = 0; i < count; i++) {
+			std::memmove(to + (destStep * (S32)i), from + (srcStep * (S32)i), unit);
+		}
+	}
+
+	FinishBlockTransfer(size, dest, destStep, source, count);
+	return true;
+}
+
+bool Memory::BlockTransfer(const AccessSize& size, U32 dest, S32 destStep, U32 source, S32 srcStep, U32 count,
+	U32* values, const std::function<void(const U32* values)>& write)
+{
+	U32 srcMask, srcSize;
+	const U8* srcRegion = PlainRegion(source, srcMask, srcSize);
+	S32 unit = size == Word ? 4 : (size == Half ? 2 : 1);
+	S32 srcStart = source & srcMask;
+	if (!srcRegion || count == 0 || !RangeInside(srcStart, srcStep, count, unit, srcSize)) {
+		return false;
+	}
+
+	for (U32 i = 0; i < count; i++) {
+		const U8* from = srcRegion + srcStart + (srcStep * (S32)i);
+		values[i] = 0;
+		for (S32 byte = 0; byte < unit; byte++) {
+			values[i] |= from[byte] << (byte * 8);
+		}
+	}
+	write(values);
+
+	FinishBlockTransfer(size, dest, destStep, source, count);
+	return true;
+}
+
+void Memory::FinishBlockTransfer(const AccessSize& size, U32 dest, S32 destStep, U32 source, U32 count)
+{
+	clock->Tick(count * (AccessTicks(size, source >> 24, SEQ) + AccessTicks(size, dest >> 24, SEQ)));
+
+	// The same notifications as count separate writes
+	U32 destMask = 0, destSize = 0;
+	PlainRegion(dest, destMask, destSize);
+	S32 unit = size == Word ? 4 : (size == Half ? 2 : 1);
+	S32 destStart = dest & destMask;
+	S32 destEnd = destStart + (destStep * (S32)(count - 1));
+	auto low = (U32)std::min(destStart, destEnd);
+	auto bytes = (U32)(std::max(destStart, destEnd) + unit - low);
+	switch (dest >> 24) {
+	case 0x05:
+		if (trackDisplayWrites)
+			MarkDisplayRange(0, low, bytes);
 		break;
-	case Half:
-		clock->Tick(ticks16);
+	case 0x06:
+		if (trackDisplayWrites)
+			MarkDisplayRange(DisplayMemory::PRAM_BLOCKS, low, bytes);
 		break;
-	case Word:
-		clock->Tick(ticks32);
+	case 0x07:
+		if (trackDisplayWrites)
+			MarkDisplayRange(DisplayMemory::OAM_FIRST_BLOCK, low, bytes);
+		if (OAMWriteCallback) {
+			for (U32 i = 0; i < count; i++) {
+				OAMWriteCallback(destStart + (destStep * (S32)i), size);
+			}
+		}
 		break;
+	default:
+		break;
+	}
+#ifndef NDEBUG
+	for (U32 i = 0; i < count; i++) {
+		PublishWriteCallback(dest + (destStep * (S32)i));
+	}
+#endif
+}
+
+void Memory::MarkDisplayWrite(U32 firstBlock, U32 offset, const AccessSize& size)
+{
+	MarkDisplayRange(firstBlock, offset, size == Word ? 4 : (size == Half ? 2 : 1));
+}
+
+void Memory::MarkDisplayRange(U32 firstBlock, U32 offset, U32 bytes)
+{
+	auto lastByte = offset + bytes - 1;
+	for (auto block = firstBlock + (offset / DisplayMemory::BLOCK_SIZE);
+		 block <= firstBlock + (lastByte / DisplayMemory::BLOCK_SIZE); block++) {
+		dirtyDisplayBlocks[block / 64] |= std::uint64_t { 1 } << (block % 64);
+	}
+}
+
+void Memory::ConsumeDirtyDisplayBlocks(const std::function<void(U32)>& callback)
+{
+	for (U32 word = 0; word < dirtyDisplayBlocks.size(); word++) {
+		auto bits = dirtyDisplayBlocks[word];
+		dirtyDisplayBlocks[word] = 0;
+		while (bits) {
+			callback((word * 64) + __builtin_ctzll(bits));
+			bits &= bits - 1;
+		}
+	}
+}
+
+U32 Memory::TicksBySize(const AccessSize& size, const U32& ticks8, const U32& ticks16, const U32& ticks32)
+{
+	switch (size) {
+	case Byte:
+		return ticks8;
+	case Half:
+		return ticks16;
+	default:
+		return ticks32;
 	}
 }
 
 void Memory::Tick(const AccessSize& size, const U32& page, const Sequentiality& seq)
+{
+	clock->Tick(AccessTicks(size, page, seq));
+}
+
+U32 Memory::AccessTicks(const AccessSize& size, const U32& page, const Sequentiality& seq)
 {
 	if (seq != NSEQ && seq != SEQ) {
-		return;
+		return 0;
 	}
 	// TODO: Plus 1 cycle if GBA accesses video memory at the same time. for OAM
 	// PRAM VRAM
 	switch (page) {
 	case 0x00:
 		// BIOS
-		clock->Tick(1);
-		break;
+		return 1;
 	case 0x01:
 		// unused
-		break;
+		return 0;
 	case 0x02:
 		// WRAM 256 - 2 wait
-		TickBySize(size, 3, 3, 6);
-		break;
+		return TicksBySize(size, 3, 3, 6);
 	case 0x03:
 		// WRAM 32
-		clock->Tick(1);
-		break;
+		return 1;
 	case 0x04:
 		// IO
-		clock->Tick(1);
-		break;
+		return 1;
 	case 0x05:
 		// BG PRAM
-		TickBySize(size, 1, 1, 2);
-		break;
+		return TicksBySize(size, 1, 1, 2);
 	case 0x06:
 		// VRAM
-		TickBySize(size, 1, 1, 2);
-		break;
+		return TicksBySize(size, 1, 1, 2);
 	case 0x07:
 		// OAM
-		clock->Tick(1);
-		break;
+		return 1;
 	case 0x08:
 	case 0x09: {
 		// Game Pak ROM/FlashROM - WS0
 		auto [nseqTicks, seqTicks] = irio->GetWaitstateTicks(IRIORegisters::Waitstate::WS0);
 		auto firstAccess = (seq == SEQ) ? seqTicks : nseqTicks;
-		TickBySize(size, firstAccess, firstAccess, firstAccess + seqTicks);
-		break;
+		return TicksBySize(size, firstAccess, firstAccess, firstAccess + seqTicks);
 	}
 	case 0x0A:
 	case 0x0B: {
 		// Game Pak ROM/FlashROM - WS1
 		auto [nseqTicks, seqTicks] = irio->GetWaitstateTicks(IRIORegisters::Waitstate::WS1);
 		auto firstAccess = (seq == SEQ) ? seqTicks : nseqTicks;
-		TickBySize(size, firstAccess, firstAccess, firstAccess + seqTicks);
-		break;
+		return TicksBySize(size, firstAccess, firstAccess, firstAccess + seqTicks);
 	}
 	case 0x0C:
 	case 0x0D: {
 		// Game Pak ROM/FlashROM - WS2
 		auto [nseqTicks, seqTicks] = irio->GetWaitstateTicks(IRIORegisters::Waitstate::WS2);
 		auto firstAccess = (seq == SEQ) ? seqTicks : nseqTicks;
-		TickBySize(size, firstAccess, firstAccess, firstAccess + seqTicks);
-		break;
+		return TicksBySize(size, firstAccess, firstAccess, firstAccess + seqTicks);
 	}
 	case 0x0E: {
 		// Game Pak ROM/FlashROM
 		auto nseqTicks = irio->GetWaitstateTicks(IRIORegisters::Waitstate::WS2).nseq;
-		clock->Tick(nseqTicks);
-		break;
-	} break;
+		return nseqTicks;
+	}
 	default:
-		break;
+		return 0;
 	}
 }
 
@@ -271,6 +444,11 @@ void Memory::SetDebugWriteCallback(std::function<void(U32)> callback)
 	PublishWriteCallback = callback;
 }
 
+void Memory::SetOAMWriteCallback(std::function<void(U32, AccessSize)> callback)
+{
+	OAMWriteCallback = callback;
+}
+
 void Memory::SetIOWriteCallback(U32 address,
 	std::function<void(U32)> callback)
 {
@@ -0,0 +1,65 @@
+#include "platform/pixel_conversion.hpp"
+
+#include "utils.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+const std::size_t VECTOR_PIXELS = 8;
+
+// 0bABCDE -> 0bABCDEABC, so 0 and 31 map to 0 and 255
+static U8 Expand5(U16 channel)
+{
+	return (channel << 3) | (channel >> 2);
+}
+
+void ConvertBGR555ToRGBA8888(const U16* src, U8* dest, std::size_t count)
+{
+	std::size_t i = 0;
+
+#if defined(__SSE2__)
+	const __m128i channelMask = _mm_set1_epi16(0x1F);
+	const __m128i opaqueAlpha = _mm_set1_epi16((S16)0xFF00);
+	for (; i + VECTOR_PIXELS <= count; i += VECTOR_PIXELS) {
+		__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+		__m128i r = _mm_and_si128(pixels, channelMask);
+		__m128i g = _mm_and_si128(_mm_srli_epi16(pixels, 5), channelMask);
+		__m128i b = _mm_and_si128(_mm_srli_epi16(pixels, 10), channelMask);
+		r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+		g = _mm_or_si128(_mm_slli_epi16(g, 3), _mm_srli_epi16(g, 2));
+		b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+
+		// Interleave 16 bit RG and BA pairs into RGBA words
+		__m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+		__m128i ba = _mm_or_si128(b, opaqueAlpha);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + (i * 4)), _mm_unpacklo_epi16(rg, ba));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + (i * 4) + 16), _mm_unpackhi_epi16(rg, ba));
+	}
+#elif defined(__ARM_NEON)
+	const uint16x8_t channelMask = vdupq_n_u16(0x1F);
+	for (; i + VECTOR_PIXELS <= count; i += VECTOR_PIXELS) {
+		uint16x8_t pixels = vld1q_u16(src + i);
+		uint16x8_t r = vandq_u16(pixels, channelMask);
+		uint16x8_t g = vandq_u16(vshrq_n_u16(pixels, 5), channelMask);
+		uint16x8_t b = vandq_u16(vshrq_n_u16(pixels, 10), channelMask);
+
+		uint8x8x4_t rgba;
+		rgba.val[0] = vmovn_u16(vorrq_u16(vshlq_n_u16(r, 3), vshrq_n_u16(r, 2)));
+		rgba.val[1] = vmovn_u16(vorrq_u16(vshlq_n_u16(g, 3), vshrq_n_u16(g, 2)));
+		rgba.val[2] = vmovn_u16(vorrq_u16(vshlq_n_u16(b, 3), vshrq_n_u16(b, 2)));
+		rgba.val[3] = vdup_n_u8(0xFF);
+		vst4_u8(dest + (i * 4), rgba);
+	}
+#endif
+
+	for (; i < count; i++) {
+		const auto& pixel = src[i];
+		dest[(i * 4)] = Expand5(BIT_RANGE(pixel, 0, 4));
+		dest[(i * 4) + 1] = Expand5(BIT_RANGE(pixel, 5, 9));
+		dest[(i * 4) + 2] = Expand5(BIT_RANGE(pixel, 10, 14));
+		dest[(i * 4) + 3] = 255;
+	}
+}
@@ -1,19 +1,31 @@
 #include "platform/sfml/window.hpp"
+#include "platform/pixel_conversion.hpp"
 
 #include "utils.hpp"
 #include <iostream>
+#include <thread>
 
 WindowSFML::WindowSFML()
 	: window(sf::VideoMode(SCREEN_WIDTH * SCALE, SCREEN_HEIGHT * SCALE),
 		"gb-step", sf::Style::Titlebar)
 {
-	window.setFramerateLimit(60);
 	background.create(SCREEN_WIDTH, SCREEN_HEIGHT);
 	b.setTexture(background);
 	b.scale(SCALE, SCALE);
+	convertThread = std::thread(&WindowSFML::ConvertThreadLoop, this);
 }
 
-void WindowSFML::render(const Framebuffer& fb)
+WindowSFML::~WindowSFML()
+{
+	{
+		std::lock_guard<std::mutex> lock(convertMutex);
+		stopConverting = true;
+	}
+	convertWake.notify_one();
+	convertThread.join();
+}
+
+void WindowSFML::render()
 {
 
 	auto temp = std::chrono::high_resolution_clock::now();
@@ -23,28 +35,73 @@ void WindowSFML::render(const Framebuffer& fb)
 	//           << "ms" << std::endl;
 	begin = temp;
 
-	translateFramebuffer(fb);
-	joypad.keyUpdate();
-	background.update(sfFramebuffer.data());
+	// Uploads the frame converted since the last call and asks for the newest one.
+	// Unchanged frames keep the texture from last time.
+	bool upload;
+	U8 index;
+	{
+		std::lock_guard<std::mutex> lock(convertMutex);
+		upload = converted;
+		index = convertedIndex;
+		converted = false;
+		convertRequested = true;
+	}
+	convertWake.notify_one();
+	if (upload) {
+		background.update(sfFramebuffers[index].data());
+	}
 	window.clear();
 	window.draw(b);
+	window.display();
+}
+
+void WindowSFML::poll()
+{
+	joypad.keyUpdate();
 
 	sf::Event ev {};
 	window.pollEvent(ev);
 	if (ev.key.code == sf::Keyboard::BackSpace && ev.type == sf::Event::KeyPressed) {
-		window.setFramerateLimit(1);
+		frameTime = std::chrono::seconds(1);
 	}
-	window.display();
+
+	// Paced here instead of with setFramerateLimit, which only waits in display(),
+	// so frames that are not drawn take as long as drawn ones
+	auto now = std::chrono::steady_clock::now();
+	if (nextFrame > now) {
+		std::this_thread::sleep_until(nextFrame);
+	} else {
+		nextFrame = now;
+	}
+	nextFrame += frameTime;
 }
 
-void WindowSFML::translateFramebuffer(const Framebuffer& fb)
+void WindowSFML::ConvertThreadLoop()
 {
-	for (std::uint64_t i = 0; i < fb.size(); i++) {
-		auto base = i * 4;
-		const auto& pixel = fb[i];
-		sfFramebuffer[base] = BIT_RANGE(pixel, 0, 4) << 3;
-		sfFramebuffer[base + 1] = BIT_RANGE(pixel, 5, 9) << 3;
-		sfFramebuffer[base + 2] = BIT_RANGE(pixel, 10, 14) << 3;
-		sfFramebuffer[base + 3] = 255;
+	std::unique_lock<std::mutex> lock(convertMutex);
+	while (true) {
+		convertWake.wait(lock, [&] { return convertRequested || stopConverting; });
+		if (stopConverting) {
+			return;
+		}
+		convertRequested = false;
+
+		// render() only reads the published buffer, so the other one is free
+		U8 index = convertedIndex ^ 1;
+		lock.unlock();
+		bool newFrame = AcquireFrontBuffer();
+		if (newFrame) {
+			translateFramebuffer(FrontBuffer(), sfFramebuffers[index]);
+		}
+		lock.lock();
+		if (newFrame) {
+			convertedIndex = index;
+			converted = true;
+		}
 	}
-}
\ No newline at end of file
+}
+
+void WindowSFML::translateFramebuffer(const Framebuffer& fb, std::array<sf::Uint8, 4 * SCREEN_TOTAL>& out)
+{
+	ConvertBGR555ToRGBA8888(fb.data(), out.data(), fb.size());
+}
@@ -0,0 +1,66 @@
+#include "platform/wav_audio_sink.hpp"
+
+#include "platform/logging.hpp"
+#include <cstdlib>
+
+const U16 CHANNELS = 2, BITS_PER_SAMPLE = 16;
+const U16 BLOCK_ALIGN = CHANNELS * (BITS_PER_SAMPLE / 8);
+const U32 HEADER_SIZE = 44;
+
+// WAV fields are little endian regardless of the host
+static void WriteLE(std::ofstream& out, U32 value, U8 bytes)
+{
+	for (U8 i = 0; i < bytes; i++) {
+		out.put((char)((value >> (i * 8)) & 0xFF));
+	}
+}
+
+WavAudioSink::WavAudioSink(const std::string& path, U32 sampleRate)
+	: out(path, std::ofstream::binary)
+	, sampleRate(sampleRate)
+{
+	if (!out.is_open()) {
+		LOG_ERROR("Could not open audio dump file")
+		exit(-1);
+	}
+	WriteHeader();
+}
+
+void WavAudioSink::Close()
+{
+	if (!out.is_open()) {
+		return;
+	}
+	out.seekp(0);
+	WriteHeader();
+	out.close();
+}
+
+// https://web.archive.org/web/20141101112743/http://soundfile.sapp.org/doc/WaveFormat/
+void WavAudioSink::WriteHeader()
+{
+	out.write("RIFF", 4);
+	WriteLE(out, HEADER_SIZE - 8 + dataBytes, 4);
+	out.write("WAVE", 4);
+
+	out.write("fmt ", 4);
+	WriteLE(out, 16, 4);
+	// PCM
+	WriteLE(out, 1, 2);
+	WriteLE(out, CHANNELS, 2);
+	WriteLE(out, sampleRate, 4);
+	WriteLE(out, sampleRate * BLOCK_ALIGN, 4);
+	WriteLE(out, BLOCK_ALIGN, 2);
+	WriteLE(out, BITS_PER_SAMPLE, 2);
+
+	out.write("data", 4);
+	WriteLE(out, dataBytes, 4);
+}
+
+void WavAudioSink::Push(const S16* samples, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		WriteLE(out, (U16)samples[i], 2);
+	}
+	dataBytes += count * 2;
+}
@@ -0,0 +1,87 @@
+#include "memory/regions.hpp"
+#include "ppu/ppu.hpp"
+
+#include "utils.hpp"
+#include <algorithm>
+#include <cstring>
+
+// https://problemkaputt.de/gbatek.htm#lcdvrambitmapbgmodes
+struct BitmapLayout {
+	S32 width;
+	S32 height;
+	U8 bytesPerPixel;
+	bool pageFlip;
+};
+
+const BitmapLayout BITMAP_LAYOUTS[3] = { { 240, 160, 2, false },
+	{ 240, 160, 1, true },
+	{ 160, 128, 2, true } };
+const U32 BITMAP_FRAME_SIZE = 0xA000;
+const U16 IDENTITY_SCALE = 0x100;
+
+void PPU::BitmapBGLine(U8 bgMode)
+{
+	const U8 BG_ID = 2;
+	const auto& layout = BITMAP_LAYOUTS[bgMode - 3];
+	const U32 frameBase = layout.pageFlip ? dispCnt.frameSelect * BITMAP_FRAME_SIZE : 0;
+	const U32 pitch = layout.width * layout.bytesPerPixel;
+
+	S32 dx = bgPA[0];
+	S32 dy = bgPC[0];
+	S32 refx, refy;
+	GetAffineLineReference(BG_ID, refx, refy);
+
+	// Mode 4 indexes the BG palette, colour 0 being transparent
+	std::array<PackedPixel, 256> palette {};
+	if (layout.bytesPerPixel == 1) {
+		std::memcpy(palette.data(), disp.pram.data(), sizeof(palette));
+		for (auto& color : palette) {
+			color &= ~TRANSPARENT_PIXEL;
+		}
+		palette[0] = TRANSPARENT_PIXEL;
+	}
+
+	auto& row = rows[BG_ID];
+	if (dx == IDENTITY_SCALE && dy == 0) {
+		// Unscaled lines are a single contiguous span of the bitmap row
+		S32 y = refy >> 8;
+		if (y < 0 || y >= layout.height) {
+			return;
+		}
+		S32 startX = refx >> 8;
+		S32 first = std::max(0, -startX);
+		S32 last = std::min((S32)Screen::SCREEN_WIDTH, layout.width - startX);
+		if (first >= last) {
+			return;
+		}
+
+		const U8* src = disp.vram.data() + frameBase + (y * pitch) + ((startX + first) * layout.bytesPerPixel);
+		auto count = last - first;
+		if (layout.bytesPerPixel == 2) {
+			std::memcpy(&row[first], src, count * sizeof(PackedPixel));
+			for (auto x = first; x < last; x++) {
+				row[x] &= ~TRANSPARENT_PIXEL;
+			}
+		} else {
+			for (auto i = 0; i < count; i++) {
+				row[first + i] = palette[src[i]];
+			}
+		}
+		return;
+	}
+
+	for (U32 rowX = 0; rowX < Screen::SCREEN_WIDTH; rowX++) {
+		S32 x = (refx + (S32)rowX * dx) >> 8;
+		S32 y = (refy + (S32)rowX * dy) >> 8;
+		if (x < 0 || y < 0 || x >= layout.width || y >= layout.height) {
+			continue;
+		}
+
+		auto offset = frameBase + (y * pitch) + (x * layout.bytesPerPixel);
+		if (layout.bytesPerPixel == 2) {
+			row[rowX] = (disp.vram[offset] | (disp.vram[offset + 1] << 8)) & ~TRANSPARENT_PIXEL;
+		} else {
+			row[rowX] = palette[disp.vram[offset]];
+		}
+	}
+}
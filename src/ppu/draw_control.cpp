@@ -1,8 +1,9 @@
 #include "memory/regions.hpp"
 #include "ppu/ppu.hpp"
+#include <algorithm>
+#include <cstring>
 
 #include "utils.hpp"
-#include <map>
 
 const Window& PPU::GetActiveWindow(U16 x, U16 y)
 {
@@ -14,8 +15,7 @@ const Window& PPU::GetActiveWindow(U16 x, U16 y)
 		return windows[WindowID::Win1];
 	}
 
-	auto fbIndex = (y * Screen::SCREEN_WIDTH + x);
-	if (objFb[fbIndex].mask && dispCnt.objWindowDisplay) {
+	if (objLine[x].mask && dispCnt.objWindowDisplay) {
 		return windows[WindowID::Obj];
 	}
 
@@ -25,59 +25,52 @@ const Window& PPU::GetActiveWindow(U16 x, U16 y)
 		return fullyEnabledWindow;
 }
 
-void PPU::MergeRows(std::vector<uint8_t>& bgOrder)
+// FNV-1a over 64 bit words
+static std::uint64_t HashLine(const U16* line)
 {
-
-	//Refresh Window values
-	{
-		auto winIn = GET_HALF(WININ);
-		auto winOut = GET_HALF(WINOUT);
-
-		windows[WindowID::Win0].SetXValues(GET_HALF(WIN0H));
-		windows[WindowID::Win0].SetYValues(GET_HALF(WIN0V));
-		windows[WindowID::Win0].SetSettings(BIT_RANGE(winIn, 0, 5));
-
-		windows[WindowID::Win1].SetXValues(GET_HALF(WIN1H));
-		windows[WindowID::Win1].SetYValues(GET_HALF(WIN1V));
-		windows[WindowID::Win1].SetSettings(BIT_RANGE(winIn, 8, 13));
-
-		windows[WindowID::Outside].SetSettings(BIT_RANGE(winOut, 0, 5));
-
-		windows[WindowID::Obj].SetSettings(BIT_RANGE(winOut, 8, 13));
+	std::uint64_t hash = 0xCBF29CE484222325;
+	for (U32 x = 0; x < Screen::SCREEN_WIDTH; x += 4) {
+		std::uint64_t pixels;
+		std::memcpy(&pixels, line + x, sizeof(pixels));
+		hash = (hash ^ pixels) * 0x100000001B3;
 	}
+	return hash;
+}
 
-	const auto y = GET_HALF(VCOUNT);
+void PPU::MergeRows()
+{
+	const auto y = vCount;
 	const U16 fbIndex = y * Screen::SCREEN_WIDTH;
+	auto& frame = *fb;
+
+	// Pixels without an opaque layer show the backdrop colour
+	std::fill_n(&frame[fbIndex], Screen::SCREEN_WIDTH, GetBgColorFromPalette(0));
 
 	for (auto x = 0u; x < Screen::SCREEN_WIDTH; x++) {
 		auto pos = fbIndex + x;
 
 		const Window& activeWindow = GetActiveWindow(x, y);
 
-		OptPixel firstPrioPixel = {};
+		PackedPixel firstPrioPixel = TRANSPARENT_PIXEL;
 		U16 firstPrio = 5;
-		OptPixel secondPrioPixel = {};
+		PackedPixel secondPrioPixel = TRANSPARENT_PIXEL;
 		U16 secondPrio = 5;
 		bool applyEffects = false;
 
 		//Find highest priority background pixel, and second if alphablending is enabled
-		for (const auto& bg : bgOrder) {
+		for (U8 i = 0; i < bgOrderCount; i++) {
+			auto bg = bgOrder[i];
 			if (!activeWindow.bgEnable[bg])
 				continue;
-			auto mapX = x;
-
-			if (bgCnt[bg].mosaic)
-				mapX = mosaic.bgHSize * (mapX / mosaic.bgHSize);
-
-			if (rows[bg][mapX].has_value()) {
-				if (!firstPrioPixel.has_value()) {
+			if (IsOpaque(rows[bg][x])) {
+				if (!IsOpaque(firstPrioPixel)) {
 					firstPrio = GetLayerPriority(bg);
-					firstPrioPixel = rows[bg][mapX];
+					firstPrioPixel = rows[bg][x];
 					applyEffects = bldCnt.firstTarget[bg];
 				} else if (bldCnt.colorSpecialEffect == BldCnt::AlphaBlending) {
 					//If next found pixel is a blend target keep track of it
 					if (bldCnt.secondTarget[bg]) {
-						secondPrioPixel = rows[bg][mapX];
+						secondPrioPixel = rows[bg][x];
 						secondPrio = GetLayerPriority(bg);
 					}
 					break;
@@ -89,7 +82,7 @@ void PPU::MergeRows(std::vector<uint8_t>& bgOrder)
 
 		//Check if obj is higher priority than selected layers
 		if (activeWindow.objEnable) {
-			ObjPixel objPixel = objFb[pos];
+			ObjPixel objPixel = objLine[x];
 
 			if (objPixel.prio <= firstPrio) {
 				applyEffects = bldCnt.firstTarget[BldCnt::TargetLayer::Sprites];
@@ -102,81 +95,80 @@ void PPU::MergeRows(std::vector<uint8_t>& bgOrder)
 				if (bldCnt.secondTarget[BldCnt::TargetLayer::Sprites])
 					secondPrioPixel = objPixel.pixel;
 				else
-					secondPrioPixel = {};
+					secondPrioPixel = TRANSPARENT_PIXEL;
 			}
 		}
 
 		if (!activeWindow.sfxEnable)
 			applyEffects = false; //TODO: should this override forceblend?
 
-		if (firstPrioPixel.has_value()) {
+		if (IsOpaque(firstPrioPixel)) {
 			if (forceBlend) {
-				SetSFXPixel(firstPrioPixel, secondPrioPixel, fb[pos], BldCnt::AlphaBlending);
+				SetSFXPixel(firstPrioPixel, secondPrioPixel, frame[pos], BldCnt::AlphaBlending);
 			} else if (!applyEffects || bldCnt.colorSpecialEffect == BldCnt::None) {
-				fb[pos] = firstPrioPixel.value();
+				frame[pos] = firstPrioPixel;
 			} else {
-				SetSFXPixel(firstPrioPixel, secondPrioPixel, fb[pos], bldCnt.colorSpecialEffect);
+				SetSFXPixel(firstPrioPixel, secondPrioPixel, frame[pos], bldCnt.colorSpecialEffect);
 			}
 		}
 	}
+
+	auto hash = HashLine(&frame[fbIndex]);
+	frameChanged |= hash != lineHashes[y];
+	lineHashes[y] = hash;
 }
 
 void PPU::DrawLine()
 {
-	auto vCount = GET_HALF(VCOUNT);
-	dispCnt = DispCnt(GET_HALF(DISPCNT));
-	auto screenDisplay = dispCnt.screenDisplay;
 	auto bgMode = dispCnt.bgMode;
-	auto frame = dispCnt.frameSelect;
 	for (auto& row : rows) {
-		row.fill({});
+		row.fill(TRANSPARENT_PIXEL);
 	}
+	if (bgMode > 5) {
+		// Nothing is drawn, the line shows the backdrop instead of an old frame
+		LOG_ERROR("Unsupported bgMode")
+		objLine.fill(emptyObjPixel);
+		MergeRows();
+		return;
+	}
+	DrawObjects(vCount);
 
-	switch (bgMode) {
-	case 0: {
-		auto bgOrder = GetBGDrawOrder({ 0, 1, 2, 3 }, screenDisplay);
-		for (const auto& bg : bgOrder) {
+	for (U8 i = 0; i < bgOrderCount; i++) {
+		auto bg = bgOrder[i];
+		switch (bgMode) {
+		case 0:
 			TextBGLine(bg);
-		}
-		MergeRows(bgOrder);
-	} break;
-	case 1: {
-		auto bgOrder = GetBGDrawOrder({ 0, 1, 2 }, screenDisplay);
-		for (const auto& bg : bgOrder) {
+			break;
+		case 1:
 			if (bg == 2) {
 				RotScaleBGLine(bg);
 			} else {
 				TextBGLine(bg);
 			}
-		}
-		MergeRows(bgOrder);
-	} break;
-	case 2: {
-		auto bgOrder = GetBGDrawOrder({ 2, 3 }, screenDisplay);
-		for (const auto& bg : bgOrder) {
+			break;
+		case 2:
 			RotScaleBGLine(bg);
+			break;
+		default:
+			BitmapBGLine(bgMode);
+			break;
 		}
-		MergeRows(bgOrder);
-	} break;
-	case 3: {
-		for (U16 pixel = (vCount * Screen::SCREEN_WIDTH);
-			 pixel < ((vCount + 1) * Screen::SCREEN_WIDTH); pixel++) {
-			fb[pixel] = memory->GetHalf(VRAM_START + pixel * 2);
-		}
-	} break;
-	case 4: {
-		for (U16 pixel = (vCount * Screen::SCREEN_WIDTH);
-			 pixel < ((vCount + 1) * Screen::SCREEN_WIDTH); pixel++) {
-			auto colorID = memory->GetByte(VRAM_START + (frame * 0xA000) + pixel);
-			fb[pixel] = GetBgColorFromPalette(colorID);
+		if (bgCnt[bg].mosaic) {
+			ApplyHorizontalMosaic(rows[bg], mosaic.bgHSize);
 		}
-	} break;
-	// TODO: Actually implement Mode 5
-	default:
-		LOG_ERROR("Unsupported bgMode")
-		break;
 	}
-	return;
+	MergeRows();
+}
+
+// Every block of size pixels repeats its first pixel
+void PPU::ApplyHorizontalMosaic(std::array<PackedPixel, Screen::SCREEN_WIDTH>& row, U8 size)
+{
+	if (size == 1) {
+		return;
+	}
+	for (U16 x = 0; x < Screen::SCREEN_WIDTH; x += size) {
+		std::fill_n(&row[x], std::min<U16>(size, Screen::SCREEN_WIDTH - x), row[x]);
+	}
 }
 
 uint8_t PPU::GetLayerPriority(uint8_t layer)
@@ -184,28 +176,24 @@ uint8_t PPU::GetLayerPriority(uint8_t layer)
 	return bgCnt[layer].priority;
 }
 
-std::vector<uint8_t> PPU::GetBGDrawOrder(std::vector<uint8_t> layers,
-	uint8_t screenDisplay)
+// Backgrounds available in each mode, as a bitmask of BG IDs
+const U8 MODE_BG_LAYERS[8] = { 0b1111, 0b0111, 0b1100, 0b0100, 0b0100, 0b0100, 0, 0 };
+
+void PPU::UpdateBGDrawOrder()
 {
-	// Find active layers
-	std::vector<uint8_t> activeLayers = {};
-	for (const auto& layer : layers) {
-		if (BIT_RANGE(screenDisplay, layer, layer)) {
-			activeLayers.push_back(layer);
+	// Insertion sort of the active layers by priority, then BG ID
+	bgOrderCount = 0;
+	auto activeLayers = MODE_BG_LAYERS[dispCnt.bgMode] & dispCnt.screenDisplay;
+	for (U8 layer = 0; layer < 4; layer++) {
+		if (!BIT_RANGE(activeLayers, layer, layer)) {
+			continue;
 		}
-	}
-	// Order active layers
-	std::map<uint8_t, uint8_t> orderedLayers;
-	for (const auto& layer : activeLayers) {
-		const uint8_t NUM_BGS = 4;
-		auto layerScore = layer + GetLayerPriority(layer) * NUM_BGS;
-		orderedLayers[layerScore] = layer;
-	}
 
-	std::vector<uint8_t> resultLayers = {};
-	for (const auto& pair : orderedLayers) {
-		resultLayers.push_back(pair.second);
+		auto pos = bgOrderCount++;
+		while (pos > 0 && GetLayerPriority(bgOrder[pos - 1]) > GetLayerPriority(layer)) {
+			bgOrder[pos] = bgOrder[pos - 1];
+			pos--;
+		}
+		bgOrder[pos] = layer;
 	}
-
-	return resultLayers;
-}
\ No newline at end of file
+}
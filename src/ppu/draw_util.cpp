@@ -1,5 +1,4 @@
 #include "memory/regions.hpp"
-#include "ppu/pixel.hpp"
 #include "ppu/ppu.hpp"
 
 #include "utils.hpp"
@@ -14,43 +13,41 @@ U16 PPU::GetBgColorFromSubPalette(const U8& paletteNumber,
 U16 PPU::GetBgColorFromPalette(const U8& colorID,
 	bool obj)
 {
-	auto paletteStart = PRAM_START;
+	U32 index = colorID * 2u;
 	if (obj)
-		paletteStart += 0x200;
-	return memory->GetHalf(colorID * 2 + paletteStart);
+		index += 0x200;
+	return (disp.pram[index] | (disp.pram[index + 1] << 8)) & ~TRANSPARENT_PIXEL;
 }
 
-void PPU::SetSFXPixel(OptPixel& firstPrioPixel, OptPixel& secondPrioPixel, U16& dest, BldCnt::ColorSpecialEffect effect)
+void PPU::SetSFXPixel(PackedPixel firstPrioPixel, PackedPixel secondPrioPixel, U16& dest, BldCnt::ColorSpecialEffect effect)
 {
-	if (!firstPrioPixel.has_value())
+	if (!IsOpaque(firstPrioPixel))
 		return;
 
-	Pixel firstPixel { firstPrioPixel.value() };
-
 	switch (effect) {
 	case BldCnt::None: {
+		dest = firstPrioPixel;
 		break;
 	}
 	case BldCnt::AlphaBlending: {
 		//Blend with backdrop if possible
-		if (!secondPrioPixel.has_value() && bldCnt.secondTarget[5])
+		if (!IsOpaque(secondPrioPixel) && bldCnt.secondTarget[5])
 			secondPrioPixel = dest;
 
-		if (secondPrioPixel.has_value()) {
-			Pixel secondPixel { secondPrioPixel.value() };
-			firstPixel.Blend(secondPixel, eva, evb);
+		if (IsOpaque(secondPrioPixel)) {
+			dest = colorEffects.Blend(firstPrioPixel, secondPrioPixel);
+		} else {
+			dest = firstPrioPixel;
 		}
 		break;
 	}
 	case BldCnt::BrightnessIncrease: {
-		firstPixel.BrightnessIncrease(evy);
+		dest = colorEffects.Brighten(firstPrioPixel);
 		break;
 	}
 	case BldCnt::BrightnessDecrease: {
-		firstPixel.BrightnessDecrease(evy);
+		dest = colorEffects.Darken(firstPrioPixel);
 		break;
 	}
 	}
-
-	dest = firstPixel.Value();
 }
@@ -1,4 +1,3 @@
-#include "platform/logging.hpp"
 #include "ppu/ppu.hpp"
 
 U32 PPU::Read(const AccessSize& size, U32 address, const Sequentiality&)
@@ -12,43 +11,113 @@ U32 PPU::Read(const AccessSize& size, U32 address, const Sequentiality&)
 void PPU::Write(const AccessSize& size, U32 address, U32 value, const Sequentiality&)
 {
 	U32 actualIndex = address - LCD_IO_START;
+	WriteToSize(registers, actualIndex, value, size);
 
-	if (size == Half) {
-		switch (address) {
-		case WIN0H:
-			windows[WindowID::Win0].SetXValues(value);
-			break;
-		case WIN0V:
-			windows[WindowID::Win0].SetYValues(value);
-			break;
-		case WIN1H:
-			windows[WindowID::Win1].SetXValues(value);
-			break;
-		case WIN1V:
-			windows[WindowID::Win1].SetYValues(value);
-			break;
-		case WININ: {
-			windows[WindowID::Win0].SetSettings(BIT_RANGE(value, 0, 5));
-			windows[WindowID::Win1].SetSettings(BIT_RANGE(value, 8, 13));
-			break;
-		}
-		case WINOUT: {
-			windows[WindowID::Outside].SetSettings(BIT_RANGE(value, 0, 5));
-			windows[WindowID::Obj].SetSettings(BIT_RANGE(value, 8, 13));
-			break;
-		}
-		case MOSAIC: {
-			mosaic.bgHSize = BIT_RANGE(value, 0, 3) + 1;
-			mosaic.bgVSize = BIT_RANGE(value, 4, 7) + 1;
-			mosaic.objHSize = BIT_RANGE(value, 8, 11) + 1;
-			mosaic.objVSize = BIT_RANGE(value, 12, 15) + 1;
-		}
-		default:
-			break;
-		}
-	} else if (size == Byte && address >= WIN0H && address <= MOSAIC + 2) {
-		LOG_ERROR("Byte window write needs implemented")
-		exit(01);
+	// Refresh the decoded copy of every halfword the write touched
+	auto end = address + (size == Word ? 4 : (size == Half ? 2 : 1));
+	for (auto half = address & ~1u; half < end; half += 2) {
+		DecodeRegister(half);
 	}
-	WriteToSize(registers, actualIndex, value, size);
-}
\ No newline at end of file
+
+	// Writing a reference point reloads the internal register mid-frame
+	if (IN_RANGE(address, BG2X, BG2Y + 4)) {
+		ReloadAffineReference(0);
+	} else if (IN_RANGE(address, BG3X, BG3Y + 4)) {
+		ReloadAffineReference(1);
+	}
+}
+
+void PPU::WriteRegisterBlock(const AccessSize& size, U32 address, S32 step, const U32* values, U32 count)
+{
+	for (U32 i = 0; i < count; i++) {
+		Write(size, address + (step * (S32)i), values[i], Sequentiality::FREE);
+	}
+}
+
+void PPU::DecodeRegister(U32 address)
+{
+	U32 index = address - LCD_IO_START;
+	U16 value = registers[index] | (registers[index + 1] << 8);
+
+	switch (address) {
+	case DISPCNT:
+		dispCnt = DispCnt(value);
+		UpdateBGDrawOrder();
+		break;
+	case VCOUNT:
+		vCount = value;
+		break;
+	case BG0CNT:
+	case BG1CNT:
+	case BG2CNT:
+	case BG3CNT:
+		bgCnt[(address - BG0CNT) / 2].UpdateValue(value);
+		UpdateBGDrawOrder();
+		break;
+	case BG0HOFS:
+	case BG1HOFS:
+	case BG2HOFS:
+	case BG3HOFS:
+		bgHOffset[(address - BG0HOFS) / 4] = value & NBIT_MASK(9);
+		break;
+	case BG0VOFS:
+	case BG1VOFS:
+	case BG2VOFS:
+	case BG3VOFS:
+		bgVOffset[(address - BG0VOFS) / 4] = value & NBIT_MASK(9);
+		break;
+	case BG2PA:
+	case BG3PA:
+		bgPA[(address - BG2PA) / 0x10] = value;
+		break;
+	case BG2PB:
+	case BG3PB:
+		bgPB[(address - BG2PB) / 0x10] = value;
+		break;
+	case BG2PC:
+	case BG3PC:
+		bgPC[(address - BG2PC) / 0x10] = value;
+		break;
+	case BG2PD:
+	case BG3PD:
+		bgPD[(address - BG2PD) / 0x10] = value;
+		break;
+	case WIN0H:
+		windows[WindowID::Win0].SetXValues(value);
+		break;
+	case WIN0V:
+		windows[WindowID::Win0].SetYValues(value);
+		break;
+	case WIN1H:
+		windows[WindowID::Win1].SetXValues(value);
+		break;
+	case WIN1V:
+		windows[WindowID::Win1].SetYValues(value);
+		break;
+	case WININ:
+		windows[WindowID::Win0].SetSettings(BIT_RANGE(value, 0, 5));
+		windows[WindowID::Win1].SetSettings(BIT_RANGE(value, 8, 13));
+		break;
+	case WINOUT:
+		windows[WindowID::Outside].SetSettings(BIT_RANGE(value, 0, 5));
+		windows[WindowID::Obj].SetSettings(BIT_RANGE(value, 8, 13));
+		break;
+	case MOSAIC:
+		mosaic.bgHSize = BIT_RANGE(value, 0, 3) + 1;
+		mosaic.bgVSize = BIT_RANGE(value, 4, 7) + 1;
+		mosaic.objHSize = BIT_RANGE(value, 8, 11) + 1;
+		mosaic.objVSize = BIT_RANGE(value, 12, 15) + 1;
+		break;
+	case BLDCNT:
+		bldCnt = BldCnt { value };
+		break;
+	case BLDALPHA:
+		colorEffects.SetAlpha(BIT_RANGE(value, 0, 4), BIT_RANGE(value, 8, 12));
+		break;
+	case BLDY:
+		colorEffects.SetBrightness(BIT_RANGE(value, 0, 4));
+		break;
+	default:
+		break;
+	}
+}
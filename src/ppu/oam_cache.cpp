@@ -0,0 +1,105 @@
+#include "ppu/oam_cache.hpp"
+
+#include "utils.hpp"
+
+const U8 OBJ_DIMENSIONS[4][3][2] = { { { 1, 1 }, { 2, 1 }, { 1, 2 } },
+	{ { 2, 2 }, { 4, 1 }, { 1, 4 } },
+	{ { 4, 4 }, { 4, 2 }, { 2, 4 } },
+	{ { 8, 8 }, { 8, 4 }, { 4, 8 } } };
+const U8 TILE_PIXELS = 8;
+
+OAMCache::OAMCache()
+{
+	for (U32 entry = 0; entry < ENTRIES; entry++) {
+		Decode(entry);
+	}
+}
+
+void OAMCache::Update(U32 offset, U16 value)
+{
+	U8 entry = offset >> 3;
+	U8 half = (offset >> 1) & 0b11;
+
+	if (half == 3) {
+		auto group = entry >> 2;
+		switch (entry & 0b11) {
+		case 0:
+			pa[group] = (S16)value;
+			break;
+		case 1:
+			pb[group] = (S16)value;
+			break;
+		case 2:
+			pc[group] = (S16)value;
+			break;
+		case 3:
+			pd[group] = (S16)value;
+			break;
+		}
+		return;
+	}
+
+	if (raw[entry][half] == value) {
+		return;
+	}
+	raw[entry][half] = value;
+	Decode(entry);
+}
+
+void OAMCache::Decode(U8 entry)
+{
+	SetIndexed(entry, false);
+
+	auto attrs = ObjAttributes(raw[entry][0], raw[entry][1], raw[entry][2]);
+	// Shape 3 is prohibited and has no dimensions, such objects are never drawn
+	if (attrs.attr0.b.objShape == 3) {
+		enabled[entry] = false;
+		return;
+	}
+	auto [tilesWide, tilesHigh] = OBJ_DIMENSIONS[attrs.attr1.b.objSize][attrs.attr0.b.objShape];
+
+	affine[entry] = attrs.attr0.b.rotationScalingFlag;
+	bool doubleSize = affine[entry] && attrs.attr0.b.objDisable;
+	enabled[entry] = affine[entry] || !attrs.attr0.b.objDisable;
+
+	x[entry] = attrs.attr1.b.xCoord;
+	y[entry] = attrs.attr0.b.yCoord;
+	width[entry] = tilesWide * TILE_PIXELS;
+	height[entry] = tilesHigh * TILE_PIXELS;
+	boundsWidth[entry] = width[entry] * (doubleSize ? 2 : 1);
+	boundsHeight[entry] = height[entry] * (doubleSize ? 2 : 1);
+	horizontalFlip[entry] = !affine[entry] && attrs.attr1.b.horizontalFlip;
+	verticalFlip[entry] = !affine[entry] && attrs.attr1.b.verticalFlip;
+	mosaic[entry] = attrs.attr0.b.objMosaic;
+	mode[entry] = attrs.attr0.b.objMode;
+	colorDepth[entry] = attrs.attr0.b.colorsPalettes ? 8u : 4u;
+	affineGroup[entry] = attrs.GetRotScaleParams();
+	tileNumber[entry] = attrs.attr2.b.characterName;
+	priority[entry] = attrs.attr2.b.priority;
+	paletteNumber[entry] = attrs.attr2.b.paletteNumber;
+
+	bool onScreenX = x[entry] < Screen::SCREEN_WIDTH || (x[entry] + boundsWidth[entry]) > MAX_X;
+	SetIndexed(entry, enabled[entry] && onScreenX);
+}
+
+void OAMCache::SetIndexed(U8 entry, bool set)
+{
+	if (indexed[entry] == set) {
+		return;
+	}
+	indexed[entry] = set;
+
+	auto word = entry >> 6;
+	std::uint64_t bit = std::uint64_t { 1 } << (entry & 63);
+	for (U16 row = 0; row < boundsHeight[entry]; row++) {
+		U16 line = (y[entry] + row) & (MAX_Y - 1);
+		if (line >= Screen::SCREEN_HEIGHT) {
+			continue;
+		}
+		if (set) {
+			lineIndex[line][word] |= bit;
+		} else {
+			lineIndex[line][word] &= ~bit;
+		}
+	}
+}
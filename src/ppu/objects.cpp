@@ -1,178 +1,253 @@
 #include "memory/regions.hpp"
-#include "ppu/pixel.hpp"
 #include "ppu/ppu.hpp"
 
 #include "utils.hpp"
 
-const U16 OBJ_DIMENSIONS[4][3][2] = { { { 1, 1 }, { 2, 1 }, { 1, 2 } },
-	{ { 2, 2 }, { 4, 1 }, { 1, 4 } },
-	{ { 4, 4 }, { 4, 2 }, { 2, 4 } },
-	{ { 8, 8 }, { 8, 4 }, { 4, 8 } } };
-const U32 OAM_ENTRIES = 128;
 const U16 MAX_SPRITE_X = 512, MAX_SPRITE_Y = 256;
 
-void PPU::DrawObjects()
+// https://problemkaputt.de/gbatek.htm#lcdobjoverview
+const S32 OBJ_LINE_CYCLES = 1210, OBJ_LINE_CYCLES_HBLANK_FREE = 954;
+const S32 AFFINE_OBJ_BASE_CYCLES = 10;
+const U16 BITMAP_MODE_FIRST_OBJ_TILE = 512;
+
+void PPU::OAMWriteCallback(U32 offset, const AccessSize& size)
 {
-	objFb.fill(emptyObjPixel);
-	for (S32 i = OAM_ENTRIES - 1; i >= 0; i--) {
-		auto objAddress = OAM_START + (i * 8);
-		auto objAttr0 = memory->GetHalf(objAddress);
-		auto drawObjectEnabled = BIT_RANGE(objAttr0, 8, 9) != 0b10;
-		if (drawObjectEnabled) {
-			auto objAttr1 = memory->GetHalf(objAddress + 2);
-			auto objAttr2 = memory->GetHalf(objAddress + 4);
-			auto objAttrs = ObjAttributes(objAttr0, objAttr1, objAttr2);
-			InitTempSprite(objAttrs);
-			DrawObject(objAttrs);
-		}
+	auto end = offset + (size == Word ? 4 : 2);
+	for (auto half = offset & ~1u; half < end; half += 2) {
+		oamCache.Update(half, disp.oam[half] | (disp.oam[half + 1] << 8));
 	}
 }
 
-void PPU::InitTempSprite(ObjAttributes objAttrs)
+void PPU::EvaluateLineObjects(U16 y)
 {
-	auto [spriteWidth, spriteHeight] = OBJ_DIMENSIONS[objAttrs.attr1.b.objSize][objAttrs.attr0.b.objShape];
-	auto topLeftTile = objAttrs.attr2.b.characterName;
-	auto characterMapping = dispCnt.objMapping;
-	auto halfTiles = objAttrs.attr0.b.colorsPalettes ? 2u : 1u;
-	U16 colorDepth = objAttrs.attr0.b.colorsPalettes ? 8u : 4u;
-	auto tileYIncrement = characterMapping ? (halfTiles * spriteWidth) : 0x20;
-	auto paletteNumber = objAttrs.attr2.b.paletteNumber;
-
-	const auto TILE_PIXEL_TOTAL = TILE_PIXEL_HEIGHT * TILE_PIXEL_WIDTH;
-	const auto ROW_TILE_PIXEL_TOTAL = TILE_PIXEL_TOTAL * spriteWidth;
-	const auto SPRITE_PIXEL_WIDTH = TILE_PIXEL_WIDTH * spriteWidth;
-
-	//Transfer sprite data to tempSprite
-	tempSprite.fill({});
-	auto tempSpriteIndexStart = 0u;
-	for (U16 tileY = 0; tileY < spriteHeight; tileY++) {
-		tempSpriteIndexStart = tileY * ROW_TILE_PIXEL_TOTAL;
-		for (U16 tileX = 0; tileX < spriteWidth; tileX++) {
-			auto tempSpriteIndex = tempSpriteIndexStart;
-
-			// Find tile data
-			U16 tileNumber = topLeftTile + (tileX * halfTiles) + (tileY * tileYIncrement);
-			if (colorDepth == 8)
-				tileNumber /= 2;
-			auto startOfTileAddress = OBJ_START_ADDRESS + (tileNumber * colorDepth * TILE_PIXEL_HEIGHT);
-
-			// Transfer tile data to tempSprite
-			auto pixelAddress = startOfTileAddress;
-			for (auto pixy = 0u; pixy < TILE_PIXEL_HEIGHT; pixy++) {
-				for (auto pixx = 0u; pixx < TILE_PIXEL_WIDTH; pixx++) {
-					if (colorDepth == 4) {
-						FetchDecode4BitPixel(pixelAddress, tempSprite[tempSpriteIndex++], paletteNumber, true, true);
-						pixx++;
-						FetchDecode4BitPixel(pixelAddress, tempSprite[tempSpriteIndex++], paletteNumber, false, true);
-					} else // equal to 8
-					{
-						FetchDecode8BitPixel(pixelAddress, tempSprite[tempSpriteIndex++], true);
-					}
-					pixelAddress++;
-				}
-				tempSpriteIndex += SPRITE_PIXEL_WIDTH - TILE_PIXEL_WIDTH;
-			}
-			tempSpriteIndexStart += TILE_PIXEL_WIDTH;
-		}
-	}
-
-	if (objAttrs.attr0.b.objMosaic && (mosaic.objVSize != 1 || mosaic.objHSize != 1)) {
-		for (U16 y = 0; y < spriteHeight * TILE_PIXEL_HEIGHT; y++) {
-			U16 mapY = mosaic.objVSize * (y / mosaic.objVSize);
-			for (U16 x = 0; x < spriteWidth * TILE_PIXEL_WIDTH; x++) {
-				U16 mapX = mosaic.objHSize * (x / mosaic.objHSize);
-				auto index = x + y * SPRITE_PIXEL_WIDTH;
-				auto mapIndex = mapX + mapY * SPRITE_PIXEL_WIDTH;
-				tempSprite[index] = tempSprite[mapIndex];
-			}
+	lineObjectCount = 0;
+	const auto& lineMask = oamCache.ObjectsOnLine(y);
+	for (U8 word = 0; word < lineMask.size(); word++) {
+		auto bits = lineMask[word];
+		while (bits) {
+			lineObjects[lineObjectCount++] = (word * 64) + __builtin_ctzll(bits);
+			bits &= bits - 1;
 		}
 	}
 }
 
-void PPU::DrawObject(ObjAttributes objAttrs)
+void PPU::DrawObjects(U16 y)
 {
-	auto [spriteWidth, spriteHeight] = OBJ_DIMENSIONS[objAttrs.attr1.b.objSize][objAttrs.attr0.b.objShape];
-	auto startX = objAttrs.attr1.b.xCoord;
-	auto startY = objAttrs.attr0.b.yCoord;
-
-	const auto SPRITE_PIXEL_WIDTH = TILE_PIXEL_WIDTH * spriteWidth;
-	const auto SPRITE_PIXEL_HEIGHT = TILE_PIXEL_HEIGHT * spriteHeight;
-	const auto FLOAT_SCALE = 256;
-
-	// Initialise Affine parameters
-	auto dx = FLOAT_SCALE;
-	auto dmx = 0;
-	auto dy = 0;
-	auto dmy = FLOAT_SCALE;
-	auto rotY = SPRITE_PIXEL_HEIGHT / 2;
-	auto rotX = SPRITE_PIXEL_WIDTH / 2;
+	objLine.fill(emptyObjPixel);
+	if (!dispCnt.objDisplay) {
+		return;
+	}
+
+	EvaluateLineObjects(y);
 
-	if (objAttrs.attr0.b.rotationScalingFlag) {
-		U32 paramLocationBase = OAM_START + (0x20 * objAttrs.GetRotScaleParams());
-		dx = (S16)memory->GetHalf(paramLocationBase + 0x06u);
-		dmx = (S16)memory->GetHalf(paramLocationBase + 0x0Eu);
-		dy = (S16)memory->GetHalf(paramLocationBase + 0x16u);
-		dmy = (S16)memory->GetHalf(paramLocationBase + 0x1Eu);
-	} else {
-		if (objAttrs.attr1.b.horizontalFlip) {
-			dx = -FLOAT_SCALE;
-			rotX -= 1;
+	// Bitmap modes use the lower half of OBJ VRAM, hiding the tiles stored there
+	const U16 firstObjTile = dispCnt.bgMode >= 3 ? BITMAP_MODE_FIRST_OBJ_TILE : 0;
+
+	// Objects are processed in OAM order until the line's rendering time runs out
+	S32 cyclesLeft = dispCnt.hBlankIntervalFree ? OBJ_LINE_CYCLES_HBLANK_FREE : OBJ_LINE_CYCLES;
+	bool anyMosaic = false;
+	for (U8 i = 0; i < lineObjectCount; i++) {
+		auto entry = lineObjects[i];
+		if (oamCache.tileNumber[entry] < firstObjTile) {
+			continue;
 		}
-		if (objAttrs.attr1.b.verticalFlip) {
-			dmy = -FLOAT_SCALE;
+		if (oamCache.affine[entry]) {
+			cyclesLeft -= AFFINE_OBJ_BASE_CYCLES + oamCache.boundsWidth[entry] * 2;
+		} else {
+			cyclesLeft -= oamCache.width[entry];
+		}
+		if (cyclesLeft < 0) {
+			break;
 		}
-	}
 
-	const auto DBL_SPRITE_HEIGHT = SPRITE_PIXEL_HEIGHT * (objAttrs.attr0.b.objDisable ? 2 : 1);
-	const auto DBL_SPRITE_WIDTH = SPRITE_PIXEL_WIDTH * (objAttrs.attr0.b.objDisable ? 2 : 1);
-	const auto HALF_SPRITE_HEIGHT = DBL_SPRITE_HEIGHT / 2;
-	const auto HALF_SPRITE_WIDTH = DBL_SPRITE_WIDTH / 2;
+		anyMosaic |= oamCache.mosaic[entry];
+		if (oamCache.affine[entry]) {
+			DrawAffineObject(entry, y);
+		} else {
+			DrawObject(entry, y);
+		}
+	}
 
-	//Perform Affine Transformation
+	if (anyMosaic && mosaic.objHSize != 1) {
+		ApplyObjMosaic();
+	}
+}
 
-	S32 yAdj = -HALF_SPRITE_WIDTH * dy + -HALF_SPRITE_HEIGHT * dmy;
-	S32 xAdj = -HALF_SPRITE_WIDTH * dx + -HALF_SPRITE_HEIGHT * dmx;
-	for (U16 y = 0; y < DBL_SPRITE_HEIGHT; y++) {
-		U16 fbY = (startY + y) % MAX_SPRITE_Y;
+void PPU::DrawObject(U8 entry, U16 y)
+{
+	const U16 SPRITE_PIXEL_WIDTH = oamCache.width[entry];
+	const U16 SPRITE_PIXEL_HEIGHT = oamCache.height[entry];
+	const U16 SPRITE_TILE_WIDTH = SPRITE_PIXEL_WIDTH / TILE_PIXEL_WIDTH;
+	auto startX = oamCache.x[entry];
+	auto priority = oamCache.priority[entry];
+	auto objMode = oamCache.mode[entry];
+	auto paletteNumber = oamCache.paletteNumber[entry];
+	bool objWindow = objMode == 2;
+	bool horizontalFlip = oamCache.horizontalFlip[entry];
+	bool objMosaic = oamCache.mosaic[entry];
+
+	// Vertical mosaic repeats the first line of each block, which may be above the sprite
+	U16 lineY = objMosaic ? y - (y % mosaic.objVSize) : y;
+	U16 texY = (lineY - oamCache.y[entry]) & (MAX_SPRITE_Y - 1);
+	if (texY >= SPRITE_PIXEL_HEIGHT) {
+		return;
+	}
+	if (oamCache.verticalFlip[entry]) {
+		texY = SPRITE_PIXEL_HEIGHT - (texY + 1);
+	}
 
-		auto xAdjLineBegin = xAdj;
-		auto yAdjLineBegin = yAdj;
+	// Tile data layout
+	U16 colorDepth = oamCache.colorDepth[entry];
+	auto halfTiles = colorDepth == 8 ? 2u : 1u;
+	auto tileYIncrement = dispCnt.objMapping ? (halfTiles * SPRITE_TILE_WIDTH) : 0x20;
+	U16 rowTileNumber = oamCache.tileNumber[entry] + ((texY / TILE_PIXEL_HEIGHT) * tileYIncrement);
+	auto positionInTileY = (texY % TILE_PIXEL_HEIGHT) * colorDepth;
+
+	// Blit each tile's row straight from VRAM, walking the tiles backwards when flipped
+	for (U16 tileX = 0; tileX < SPRITE_TILE_WIDTH; tileX++) {
+		U16 screenTileX = horizontalFlip ? (SPRITE_TILE_WIDTH - (tileX + 1)) : tileX;
+		U16 tileStartX = (startX + (screenTileX * TILE_PIXEL_WIDTH)) % MAX_SPRITE_X;
+		if (tileStartX >= Screen::SCREEN_WIDTH && tileStartX + TILE_PIXEL_WIDTH <= MAX_SPRITE_X) {
+			continue;
+		}
 
-		for (U16 x = 0; x < DBL_SPRITE_WIDTH; x++) {
-			S16 newX = xAdj / FLOAT_SCALE + rotX;
-			S16 newY = yAdj / FLOAT_SCALE + rotY;
-			xAdj += dx;
-			yAdj += dy;
+		U16 tileNumber = rowTileNumber + (tileX * halfTiles);
+		if (colorDepth == 8)
+			tileNumber /= 2;
+		auto rowOffset = OBJ_VRAM_OFFSET + (((tileNumber * colorDepth * TILE_PIXEL_HEIGHT) + positionInTileY) & OBJ_VRAM_MASK);
 
-			if (newX >= SPRITE_PIXEL_WIDTH || newY >= SPRITE_PIXEL_HEIGHT || newX < 0 || newY < 0)
+		for (U16 px = 0; px < TILE_PIXEL_WIDTH; px++) {
+			U16 fbX = (tileStartX + (horizontalFlip ? (TILE_PIXEL_WIDTH - (px + 1)) : px)) % MAX_SPRITE_X;
+			if (fbX >= Screen::SCREEN_WIDTH) {
 				continue;
-			auto tempSpriteIndex = newY * SPRITE_PIXEL_WIDTH + newX;
+			}
+			// Lower OAM entries were drawn first and win priority ties
+			if (!objWindow && objLine[fbX].prio <= priority) {
+				continue;
+			}
 
-			U16 fbX = (startX + x) % MAX_SPRITE_X;
-			if (fbX < Screen::SCREEN_WIDTH && fbY < Screen::SCREEN_HEIGHT) {
-				auto fbPos = fbX + (Screen::SCREEN_WIDTH * fbY);
-				if (objFb[fbPos].prio < objAttrs.attr2.b.priority) {
-					continue;
+			U8 colorID;
+			if (colorDepth == 4) {
+				colorID = disp.vram[rowOffset + (px / 2)];
+				colorID = (px % 2 == 0) ? BIT_RANGE(colorID, 0, 3) : BIT_RANGE(colorID, 4, 7);
+				if (colorID != 0) {
+					SetObjPixel(GetBgColorFromSubPalette(paletteNumber, colorID, true), fbX, objMode, priority, objMosaic);
+				}
+			} else // equal to 8
+			{
+				colorID = disp.vram[rowOffset + px];
+				if (colorID != 0) {
+					SetObjPixel(GetBgColorFromPalette(colorID, true), fbX, objMode, priority, objMosaic);
 				}
-				SetObjPixel(tempSprite[tempSpriteIndex], fbPos, objAttrs.attr0.b.objMode, objAttrs.attr2.b.priority);
 			}
 		}
+	}
+}
+
+void PPU::DrawAffineObject(U8 entry, U16 y)
+{
+	auto startX = oamCache.x[entry];
+	auto startY = oamCache.y[entry];
+
+	const S32 SPRITE_PIXEL_WIDTH = oamCache.width[entry];
+	const S32 SPRITE_PIXEL_HEIGHT = oamCache.height[entry];
+
+	// Affine parameters
+	auto group = oamCache.affineGroup[entry];
+	S32 dx = oamCache.pa[group];
+	S32 dmx = oamCache.pb[group];
+	S32 dy = oamCache.pc[group];
+	S32 dmy = oamCache.pd[group];
+	auto rotY = SPRITE_PIXEL_HEIGHT / 2;
+	auto rotX = SPRITE_PIXEL_WIDTH / 2;
+
+	const S32 DBL_SPRITE_HEIGHT = oamCache.boundsHeight[entry];
+	const S32 DBL_SPRITE_WIDTH = oamCache.boundsWidth[entry];
+	const S32 HALF_SPRITE_HEIGHT = DBL_SPRITE_HEIGHT / 2;
+	const S32 HALF_SPRITE_WIDTH = DBL_SPRITE_WIDTH / 2;
+
+	// Tile data layout
+	auto topLeftTile = oamCache.tileNumber[entry];
+	U16 colorDepth = oamCache.colorDepth[entry];
+	auto halfTiles = colorDepth == 8 ? 2u : 1u;
+	auto tileYIncrement = dispCnt.objMapping ? (halfTiles * SPRITE_PIXEL_WIDTH / TILE_PIXEL_WIDTH) : 0x20;
+	auto paletteNumber = oamCache.paletteNumber[entry];
+	auto priority = oamCache.priority[entry];
+	auto objMode = oamCache.mode[entry];
+	bool objMosaic = oamCache.mosaic[entry];
+	bool objWindow = objMode == 2;
+
+	//Perform Affine Transformation for the row of the sprite on this line
+	U16 lineY = objMosaic ? y - (y % mosaic.objVSize) : y;
+	S32 spriteLine = (lineY - startY) & (MAX_SPRITE_Y - 1);
+	if (spriteLine >= DBL_SPRITE_HEIGHT) {
+		return;
+	}
+	S32 xAdj = -HALF_SPRITE_WIDTH * dx + (spriteLine - HALF_SPRITE_HEIGHT) * dmx;
+	S32 yAdj = -HALF_SPRITE_WIDTH * dy + (spriteLine - HALF_SPRITE_HEIGHT) * dmy;
+
+	for (S32 x = 0; x < DBL_SPRITE_WIDTH; x++, xAdj += dx, yAdj += dy) {
+		U16 fbX = (startX + x) % MAX_SPRITE_X;
+		if (fbX >= Screen::SCREEN_WIDTH) {
+			continue;
+		}
+		// Lower OAM entries were drawn first and win priority ties
+		if (!objWindow && objLine[fbX].prio <= priority) {
+			continue;
+		}
 
-		xAdj = xAdjLineBegin + dmx;
-		yAdj = yAdjLineBegin + dmy;
+		S32 texX = (xAdj >> 8) + rotX;
+		S32 texY = (yAdj >> 8) + rotY;
+		if (texX >= SPRITE_PIXEL_WIDTH || texY >= SPRITE_PIXEL_HEIGHT || texX < 0 || texY < 0)
+			continue;
+
+		// Find tile data
+		U16 tileNumber = topLeftTile + ((texX / TILE_PIXEL_WIDTH) * halfTiles) + ((texY / TILE_PIXEL_HEIGHT) * tileYIncrement);
+		if (colorDepth == 8)
+			tileNumber /= 2;
+		auto pixX = texX % TILE_PIXEL_WIDTH;
+		auto pixelOffset = (tileNumber * colorDepth * TILE_PIXEL_HEIGHT) + ((texY % TILE_PIXEL_HEIGHT) * colorDepth) + (pixX * colorDepth / 8);
+		auto pixelAddress = OBJ_START_ADDRESS + (pixelOffset & OBJ_VRAM_MASK);
+
+		PackedPixel pixel = TRANSPARENT_PIXEL;
+		if (colorDepth == 4) {
+			FetchDecode4BitPixel(pixelAddress, pixel, paletteNumber, (pixX % 2 == 0), true);
+		} else // equal to 8
+		{
+			FetchDecode8BitPixel(pixelAddress, pixel, true);
+		}
+		SetObjPixel(pixel, fbX, objMode, priority, objMosaic);
 	}
 }
 
-void PPU::SetObjPixel(OptPixel& pixel, U32 fbPos, U8 objMode, U16 prio)
+void PPU::SetObjPixel(const PackedPixel& pixel, U16 x, U8 objMode, U16 prio, bool objMosaic)
 {
-	if (pixel) {
+	if (IsOpaque(pixel)) {
 		if (objMode == 2) {
-			objFb[fbPos].mask = true;
+			objLine[x].mask = true;
 			return;
 		}
 
-		objFb[fbPos].pixel = pixel;
-		objFb[fbPos].prio = prio;
-		objFb[fbPos].transparency = (objMode == 1);
+		objLine[x].pixel = pixel;
+		objLine[x].prio = prio;
+		objLine[x].transparency = (objMode == 1);
+		objLine[x].mosaic = objMosaic;
 	}
-}
\ No newline at end of file
+}
+
+// Mosaic objects repeat the first pixel of each horizontal block, unless
+// another object's pixel has priority there
+void PPU::ApplyObjMosaic()
+{
+	for (U16 x = 0; x < Screen::SCREEN_WIDTH; x++) {
+		const auto& anchor = objLine[x - (x % mosaic.objHSize)];
+		auto& pixel = objLine[x];
+		if (!anchor.mosaic || (IsOpaque(pixel.pixel) && !pixel.mosaic && pixel.prio < anchor.prio)) {
+			continue;
+		}
+		pixel.pixel = anchor.pixel;
+		pixel.prio = anchor.prio;
+		pixel.transparency = anchor.transparency;
+		pixel.mosaic = true;
+	}
+}
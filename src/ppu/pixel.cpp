@@ -0,0 +1,25 @@
+#include "ppu/pixel.hpp"
+
+using BrightnessTables = std::array<ColorEffects::ChannelTable, ColorEffects::COEFFICIENT_LEVELS>;
+
+template <bool increase>
+BrightnessTables MakeBrightnessTables()
+{
+	BrightnessTables tables {};
+	for (U8 evy = 0; evy < ColorEffects::COEFFICIENT_LEVELS; evy++) {
+		for (U8 c = 0; c < tables[evy].size(); c++) {
+			tables[evy][c] = increase ? c + ((31 - c) * evy) / 16 : c - (c * evy) / 16;
+		}
+	}
+	return tables;
+}
+
+const BrightnessTables BRIGHTEN = MakeBrightnessTables<true>();
+const BrightnessTables DARKEN = MakeBrightnessTables<false>();
+
+void ColorEffects::SetBrightness(U8 evy)
+{
+	evy = std::min(evy, MAX_COEFFICIENT);
+	brighten = &BRIGHTEN[evy];
+	darken = &DARKEN[evy];
+}
@@ -1,17 +1,14 @@
 #include "ppu/ppu.hpp"
 #include "memory/regions.hpp"
+#include <algorithm>
 
 #include "utils.hpp"
-#include <map>
 
 const U32 CYCLES_PER_VISIBLE = 960, CYCLES_PER_HBLANK = 272,
 		  CYCLES_PER_LINE = CYCLES_PER_VISIBLE + CYCLES_PER_HBLANK,
 		  VISIBLE_LINES = 160, VBLANK_LINES = 68,
 		  TOTAL_LINES = VISIBLE_LINES + VBLANK_LINES;
 
-const U32 BGX[2] = { BG2X, BG3X };
-const U32 BGY[2] = { BG2Y, BG3Y };
-
 enum DispStatInfo {
 	VBlankFlag = 0,
 	HBlankFlag = 1,
@@ -22,41 +19,111 @@ enum DispStatInfo {
 	VCountSetting = 6
 };
 
+PPU::PPU(std::shared_ptr<Memory> memory_, Screen& screen_,
+	std::shared_ptr<IRQChannel> irqChannel_,
+	std::function<void(bool)> HBlankCallback_,
+	std::function<void(bool)> VBlankCallback_,
+	bool threadedRender)
+	: memory(memory_)
+	, disp(memory_->GetDisplayMemory())
+	, screen(screen_)
+	, irqChannel(irqChannel_)
+	, HBlankCallback(HBlankCallback_)
+	, VBlankCallback(VBlankCallback_)
+	, fb(&screen_.GetBackBuffer())
+{
+	if (threadedRender) {
+		workerDisp = std::make_unique<Memory::DisplayMemory>(disp);
+		renderer = std::unique_ptr<PPU>(new PPU(*workerDisp, screen));
+		renderQueue = std::make_unique<SPSCQueue<RenderCommand, RENDER_QUEUE_SIZE>>();
+		memory->SetDisplayWriteTracking(true);
+		renderThread = std::thread(&PPU::RenderThreadLoop, this);
+	}
+}
+
+PPU::PPU(const Memory::DisplayMemory& disp_, Screen& screen_)
+	: disp(disp_)
+	, screen(screen_)
+	, fb(&screen_.GetBackBuffer())
+{
+}
+
+PPU::~PPU()
+{
+	StopRenderThread();
+}
+
+void PPU::StopRenderThread()
+{
+	if (renderThread.joinable()) {
+		RenderCommand command;
+		command.type = RenderCommand::Stop;
+		PushRenderCommand(command);
+		WakeRenderThread();
+		renderThread.join();
+	}
+}
+
 void PPU::Execute(U32 ticks)
 {
 	tickCount += ticks;
 
-	// https://problemkaputt.de/gbatek.htm#lcddimensionsandtimings
-	switch (state) {
-	case Visible: {
-		if (tickCount > CYCLES_PER_VISIBLE) {
-			tickCount = tickCount - CYCLES_PER_VISIBLE;
-			ToHBlank();
+	// Bulk DMA can charge more than one state's worth of cycles at once. Catching up
+	// stops after raising an HBlank or VBlank trigger, so the DMA controller sees it
+	// before it is dropped again; the rest is carried over to the next call.
+	bool advanced = true;
+	while (advanced) {
+		advanced = false;
+		// https://problemkaputt.de/gbatek.htm#lcddimensionsandtimings
+		switch (state) {
+		case Visible: {
+			if (tickCount > CYCLES_PER_VISIBLE) {
+				tickCount = tickCount - CYCLES_PER_VISIBLE;
+				ToHBlank();
+			}
+			break;
 		}
-		break;
-	}
-	case HBlank: {
-		if (tickCount > CYCLES_PER_HBLANK) {
-			tickCount = tickCount - CYCLES_PER_HBLANK;
-			OnHBlankFinish();
+		case HBlank: {
+			if (tickCount > CYCLES_PER_HBLANK) {
+				tickCount = tickCount - CYCLES_PER_HBLANK;
+				OnHBlankFinish();
+				advanced = state != VBlank;
+			}
+			break;
+		}
+		case VBlank: {
+			if (tickCount > CYCLES_PER_LINE) {
+				tickCount = tickCount - CYCLES_PER_LINE;
+				OnVBlankLineFinish();
+				advanced = true;
+			}
+			break;
 		}
-		break;
-	}
-	case VBlank: {
-		if (tickCount > CYCLES_PER_LINE) {
-			tickCount = tickCount - CYCLES_PER_LINE;
-			OnVBlankLineFinish();
 		}
-		break;
 	}
+}
+
+U32 PPU::CyclesToNextState() const
+{
+	U32 length = CYCLES_PER_LINE;
+	if (state == Visible) {
+		length = CYCLES_PER_VISIBLE;
+	} else if (state == HBlank) {
+		length = CYCLES_PER_HBLANK;
 	}
+	return tickCount < length ? length - tickCount + 1 : 0;
 }
 
 void PPU::ToHBlank()
 {
 	state = HBlank;
 	HBlankCallback(true);
-	DrawLine();
+	if (drawFrame && renderer) {
+		QueueLine();
+	} else if (drawFrame) {
+		DrawLine();
+	}
+	StepAffineReferences();
 	UpdateDispStat(HBlankFlag, true);
 
 	if (GetDispStat(HBlankIRQEnable)) {
@@ -83,9 +150,11 @@ void PPU::OnHBlankFinish()
 void PPU::ToVBlank()
 {
 	state = VBlank;
-	DrawObjects();
-	screen.render(fb);
-	fb.fill(memory->GetHalf(PRAM_START));
+	framesCompleted++;
+	if (drawFrame) {
+		PresentFrame();
+	}
+	screen.poll();
 
 	// Set VBlank flag and Request Interrupt
 	UpdateDispStat(VBlankFlag, true);
@@ -105,37 +174,11 @@ void PPU::OnVBlankLineFinish()
 		UpdateDispStat(VBlankFlag, false);
 	}
 	if (vCount >= TOTAL_LINES) {
-		//TODO: Move these too own functions
-
 		//Reload RotScale registers
-		{
-			for (auto bgId = 2; bgId <= 3; bgId++) {
-				auto bgX = memory->GetWord(BGX[bgId - 2]);
-				bgXRef[bgId - 2] = bgX;
-				if (BIT_RANGE(bgX, 27, 27))
-					bgXRef[bgId - 2] |= 0xF0000000;
-				auto bgY = memory->GetWord(BGY[bgId - 2]);
-				bgYRef[bgId - 2] = bgY;
-				if (BIT_RANGE(bgY, 27, 27))
-					bgYRef[bgId - 2] |= 0xF0000000;
-			}
-			bldCnt = BldCnt { GET_HALF(BLDCNT) };
-			U16 bldAlpha = GET_HALF(BLDALPHA);
-			eva = BIT_RANGE(bldAlpha, 0, 4);
-			if (eva > 16) {
-				eva = 16;
-			}
-			evb = BIT_RANGE(bldAlpha, 8, 12);
-			if (evb > 16) {
-				evb = 16;
-			}
-			U16 bldY = GET_HALF(BLDY);
-			evy = BIT_RANGE(bldY, 0, 4);
-			if (evy > 16) {
-				evy = 16;
-			}
-		}
+		ReloadAffineReference(0);
+		ReloadAffineReference(1);
 
+		drawFrame = DrawNextFrame();
 		memory->SetHalf(VCOUNT, 0);
 		VBlankCallback(false);
 		state = Visible;
@@ -179,4 +222,124 @@ U16 PPU::IncrementVCount()
 	}
 
 	return vCount;
-}
\ No newline at end of file
+}
+
+void PPU::SetRenderPolicy(RenderPolicy policy, U32 interval)
+{
+	renderPolicy = policy;
+	frameInterval = std::max(interval, 1u);
+	frameCount = 0;
+	drawFrame = DrawNextFrame();
+}
+
+bool PPU::DrawNextFrame()
+{
+	switch (renderPolicy) {
+	case RenderPolicy::Always:
+		return true;
+	case RenderPolicy::EveryNthFrame:
+		return (frameCount++ % frameInterval) == 0;
+	case RenderPolicy::Never:
+		return false;
+	}
+	return true;
+}
+
+void PPU::PresentFrame()
+{
+	if (renderer) {
+		// The render thread sleeps until the next visible line once it catches up
+		while (linesPending.load(std::memory_order_acquire) != 0) {
+			std::this_thread::yield();
+		}
+	}
+	auto& drawer = renderer ? *renderer : *this;
+	screen.SwapBuffers(drawer.frameChanged);
+	drawer.frameChanged = false;
+	drawer.fb = &screen.GetBackBuffer();
+	screen.render();
+}
+
+// Hands the line to the render thread: display memory written since the last
+// line is mirrored first, then the line is drawn from a copy of the registers
+void PPU::QueueLine()
+{
+	RenderCommand command;
+	command.type = RenderCommand::DisplayBlock;
+	memory->ConsumeDirtyDisplayBlocks([&](U32 block) {
+		command.block = block;
+		std::copy_n(disp.Block(block), command.data.size(), command.data.begin());
+		PushRenderCommand(command);
+	});
+
+	command.type = RenderCommand::Line;
+	command.lcdRegisters = registers;
+	command.bgXRef = bgXRef;
+	command.bgYRef = bgYRef;
+	linesPending.fetch_add(1, std::memory_order_relaxed);
+	PushRenderCommand(command);
+	WakeRenderThread();
+}
+
+void PPU::PushRenderCommand(const RenderCommand& command)
+{
+	while (!renderQueue->Push(command)) {
+		std::this_thread::yield();
+	}
+}
+
+// Only lines and Stop wake the render thread, display blocks are always followed by a line.
+// Taking the lock before notifying means a wake can't fall between the render
+// thread finding the queue empty and it starting to wait.
+void PPU::WakeRenderThread()
+{
+	{
+		std::lock_guard<std::mutex> lock(renderMutex);
+	}
+	renderWake.notify_one();
+}
+
+void PPU::RenderThreadLoop()
+{
+	RenderCommand command;
+	while (true) {
+		if (!renderQueue->Pop(command)) {
+			std::unique_lock<std::mutex> lock(renderMutex);
+			renderWake.wait(lock, [&] { return !renderQueue->IsEmpty(); });
+			continue;
+		}
+
+		switch (command.type) {
+		case RenderCommand::DisplayBlock: {
+			std::copy(command.data.begin(), command.data.end(), workerDisp->Block(command.block));
+			if (command.block >= Memory::DisplayMemory::OAM_FIRST_BLOCK) {
+				auto offset = (command.block - Memory::DisplayMemory::OAM_FIRST_BLOCK) * Memory::DisplayMemory::BLOCK_SIZE;
+				for (U32 half = 0; half < command.data.size(); half += 2) {
+					renderer->OAMWriteCallback(offset + half, Half);
+				}
+			}
+			break;
+		}
+		case RenderCommand::Line:
+			renderer->ApplyLineSnapshot(command);
+			renderer->DrawLine();
+			linesPending.fetch_sub(1, std::memory_order_release);
+			break;
+		case RenderCommand::Stop:
+			return;
+		}
+	}
+}
+
+void PPU::ApplyLineSnapshot(const RenderCommand& command)
+{
+	// Registers go through Write so the decoded copies are refreshed
+	for (U32 offset = 0; offset < LCD_IO_SIZE; offset += 2) {
+		U16 value = command.lcdRegisters[offset] | (command.lcdRegisters[offset + 1] << 8);
+		if (value != (registers[offset] | (registers[offset + 1] << 8))) {
+			Write(Half, LCD_IO_START + offset, value, FREE);
+		}
+	}
+	bgXRef = command.bgXRef;
+	bgYRef = command.bgYRef;
+}
@@ -3,66 +3,88 @@
 
 #include "utils.hpp"
 
-const U16 ROTSCALE_BGMAP_SIZES[4][2] = { { 128, 128 },
-	{ 256, 256 },
-	{ 512, 512 },
-	{ 1024, 1024 } };
+const U32 BGX[2] = { BG2X, BG3X };
+const U32 BGY[2] = { BG2Y, BG3Y };
 
-const U32 BGPA[2] = { BG2PA, BG3PA };
-const U32 BGPB[2] = { BG2PB, BG3PB };
-const U32 BGPC[2] = { BG2PC, BG3PC };
-const U32 BGPD[2] = { BG2PD, BG3PD };
+// Rotscale maps are square, 128 << screenSize pixels wide
+const U8 ROTSCALE_BGMAP_MIN_SHIFT = 7;
 
-void PPU::RotScaleBGLine(const U32& BG_ID)
+void PPU::ReloadAffineReference(U8 affineId)
 {
-	bgCnt[BG_ID].UpdateValue(GET_HALF(BGCNT[BG_ID]));
+	// 28 bit signed 20.8 fixed point values
+	auto bgX = ReadToSize(registers, BGX[affineId] - LCD_IO_START, Word);
+	bgXRef[affineId] = (S32)(bgX << 4) >> 4;
+	auto bgY = ReadToSize(registers, BGY[affineId] - LCD_IO_START, Word);
+	bgYRef[affineId] = (S32)(bgY << 4) >> 4;
+}
+
+void PPU::StepAffineReferences()
+{
+	for (U8 affineId = 0; affineId < 2; affineId++) {
+		bgXRef[affineId] += bgPB[affineId];
+		bgYRef[affineId] += bgPD[affineId];
+	}
+}
+
+void PPU::GetAffineLineReference(const U32& BG_ID, S32& refx, S32& refy)
+{
+	const auto affineId = BG_ID - 2;
+	refx = bgXRef[affineId];
+	refy = bgYRef[affineId];
+	//Step back to the first line of the mosaic block
+	if (bgCnt[BG_ID].mosaic) {
+		auto mosaicLine = vCount % mosaic.bgVSize;
+		refx -= mosaicLine * bgPB[affineId];
+		refy -= mosaicLine * bgPD[affineId];
+	}
+}
 
-	auto dx = (S16)GET_HALF(BGPA[BG_ID - 2]);
-	auto dmx = (S16)GET_HALF(BGPB[BG_ID - 2]);
-	auto dy = (S16)GET_HALF(BGPC[BG_ID - 2]);
-	auto dmy = (S16)GET_HALF(BGPD[BG_ID - 2]);
+void PPU::RotScaleBGLine(const U32& BG_ID)
+{
+	const auto& bg = bgCnt[BG_ID];
+	const auto affineId = BG_ID - 2;
 
-	auto [maxX, maxY] = ROTSCALE_BGMAP_SIZES[bgCnt[BG_ID].screenSize];
+	S32 dx = bgPA[affineId];
+	S32 dy = bgPC[affineId];
 
-	auto y = GET_HALF(VCOUNT);
-	//floor to mosaic
-	if (bgCnt[BG_ID].mosaic)
-		y = (y / mosaic.bgVSize) * mosaic.bgVSize;
+	const U8 mapShift = ROTSCALE_BGMAP_MIN_SHIFT + bg.screenSize;
+	const S32 mapSizeMask = (1 << mapShift) - 1;
 
-	auto refx = bgXRef[BG_ID - 2] + (y * (S32)dmx);
-	auto refy = bgYRef[BG_ID - 2] + (y * (S32)dmy);
-	for (auto rowX = 0u; rowX < Screen::SCREEN_WIDTH; rowX++) {
+	S32 refx, refy;
+	GetAffineLineReference(BG_ID, refx, refy);
 
-		//Calculate Position in map
-		auto x = refx / 256;
-		auto y = refy / 256;
-		bool negativeCoords = (refx < 0) || (refy < 0);
-		refx += dx;
-		refy += dy;
+	//Calculate Position in map
+	std::array<S32, Screen::SCREEN_WIDTH> mapXs, mapYs;
+	for (U32 rowX = 0; rowX < Screen::SCREEN_WIDTH; rowX++) {
+		mapXs[rowX] = (refx + (S32)rowX * dx) >> 8;
+		mapYs[rowX] = (refy + (S32)rowX * dy) >> 8;
+	}
+	if (bg.wrapAround) {
+		for (U32 rowX = 0; rowX < Screen::SCREEN_WIDTH; rowX++) {
+			mapXs[rowX] &= mapSizeMask;
+			mapYs[rowX] &= mapSizeMask;
+		}
+	}
 
-		if (x >= maxX || y >= maxY || negativeCoords) {
-			if (bgCnt[BG_ID].wrapAround) {
-				x %= maxX;
-				y %= maxY;
-				if (x < 0)
-					x += maxX;
-				if (y < 0)
-					y += maxY;
-			} else {
-				continue;
-			}
+	//Draw Pixels
+	const U32 mapBase = bg.mapDataBase - VRAM_START;
+	const U32 tileBase = bg.tileDataBase - VRAM_START;
+	const U16 BYTES_PER_TILE = TILE_PIXEL_WIDTH * TILE_PIXEL_HEIGHT;
+	auto& row = rows[BG_ID];
+	for (U32 rowX = 0; rowX < Screen::SCREEN_WIDTH; rowX++) {
+		auto x = mapXs[rowX];
+		auto y = mapYs[rowX];
+		if ((x | y) & ~mapSizeMask) {
+			continue;
 		}
-		auto mapX = x / TILE_PIXEL_WIDTH;
+
+		auto mapIndex = ((y / TILE_PIXEL_HEIGHT) << (mapShift - 3)) + (x / TILE_PIXEL_WIDTH);
+		auto tileNumber = disp.vram[mapBase + mapIndex];
 		auto tileX = x % TILE_PIXEL_WIDTH;
-		auto mapY = y / TILE_PIXEL_HEIGHT;
 		auto tileY = y % TILE_PIXEL_HEIGHT;
-		auto mapWidth = maxX / TILE_PIXEL_WIDTH;
-		auto mapIndex = (mapY * mapWidth) + mapX;
-
-		//Draw Pixel
-		auto tileNumber = memory->GetByte(bgCnt[BG_ID].mapDataBase + mapIndex);
-		const U16 BYTES_PER_TILE = TILE_PIXEL_WIDTH * TILE_PIXEL_HEIGHT;
-		auto pixelAddress = bgCnt[BG_ID].tileDataBase + (tileNumber * BYTES_PER_TILE) + (tileY * TILE_PIXEL_WIDTH) + tileX;
-		FetchDecode8BitPixel(pixelAddress, rows[BG_ID][rowX], false);
+		auto colorID = disp.vram[tileBase + (tileNumber * BYTES_PER_TILE) + (tileY * TILE_PIXEL_WIDTH) + tileX];
+		if (colorID != 0) {
+			row[rowX] = GetBgColorFromPalette(colorID);
+		}
 	}
 }
@@ -3,8 +3,6 @@
 #include "ppu/ppu.hpp"
 #include "utils.hpp"
 
-const U32 BGHOFS[4] = { BG0HOFS, BG1HOFS, BG2HOFS, BG3HOFS };
-const U32 BGVOFS[4] = { BG0VOFS, BG1VOFS, BG2VOFS, BG3VOFS };
 const U16 TEXT_BGMAP_SIZES[4][2] = { { 256, 256 },
 	{ 512, 256 },
 	{ 256, 512 },
@@ -13,12 +11,10 @@ const U32 BYTES_PER_ENTRY = 2;
 
 void PPU::TextBGLine(const U32& BG_ID)
 {
-	bgCnt[BG_ID] = BGControlInfo(BG_ID, GET_HALF(BGCNT[BG_ID]));
+	auto bgXOffset = bgHOffset[BG_ID];
+	auto bgYOffset = bgVOffset[BG_ID];
 
-	auto bgXOffset = GET_HALF(BGHOFS[BG_ID]) & NBIT_MASK(9);
-	auto bgYOffset = GET_HALF(BGVOFS[BG_ID]) & NBIT_MASK(9);
-
-	auto y = GET_HALF(VCOUNT);
+	auto y = vCount;
 
 	//floor to mosaic
 	if (bgCnt[BG_ID].mosaic)
@@ -45,7 +41,8 @@ void PPU::TextBGLine(const U32& BG_ID)
 
 		auto screenAreaAddressInc = GetScreenAreaOffset(mapX, mapY, bgCnt[BG_ID].screenSize);
 		// Parse tile data
-		auto bgMapEntry = memory->GetHalf(bgCnt[BG_ID].mapDataBase + screenAreaAddressInc + (mapIndex * BYTES_PER_ENTRY));
+		auto mapEntryOffset = bgCnt[BG_ID].mapDataBase - VRAM_START + screenAreaAddressInc + (mapIndex * BYTES_PER_ENTRY);
+		U16 bgMapEntry = disp.vram[mapEntryOffset] | (disp.vram[mapEntryOffset + 1] << 8);
 		auto tileNumber = BIT_RANGE(bgMapEntry, 0, 9);
 		bool horizontalFlip = BIT_RANGE(bgMapEntry, 10, 10);
 		bool verticalFlip = BIT_RANGE(bgMapEntry, 11, 11);
@@ -18,8 +18,11 @@ void Timers::Update(const U32 ticks)
 			irqChannel->RequestInterrupt(timerInterrupts[timerIndex]);
 		}
 
-		if (overflow && (timerIndex == 0 || timerIndex == 1)) {
-			apuCallback(timerIndex);
+		// The sound FIFOs pop one sample per overflow
+		if (timerIndex == 0 || timerIndex == 1) {
+			for (auto i = 0u; i < overflow; i++) {
+				apuCallback(timerIndex);
+			}
 		}
 	}
 }